@@ -0,0 +1,124 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include "../src/fs/FileSystem.h"
+#include "../src/utils/StringNumberConverter.h"
+
+namespace {
+
+    /// Disk sizes in megabytes benchmarked when none are passed
+    const std::vector<std::size_t> DEFAULT_DISK_SIZES = { 16000, 64000, 256000 };
+    /// Size of the file written into every formatted file system, spanning several allocation groups
+    constexpr std::size_t SAMPLE_FILE_SIZE = 64 * 1000000;
+
+    /// Returns milliseconds elapsed since given time point
+    double elapsedMs(const std::chrono::steady_clock::time_point& start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Returns the number of bytes actually allocated by given file, data files are mostly sparse
+    std::size_t allocatedBytes(const std::string& fileName) {
+        struct stat fileStat {};
+        if (::stat(fileName.c_str(), &fileStat) < 0) {
+            return 0;
+        }
+        return static_cast<std::size_t>(fileStat.st_blocks) * 512;
+    }
+
+    /**
+     * Formats a file system of given size, writes a sample file, remounts the file system and reads the file back.
+     *
+     * @param fileName data file of the file system
+     * @param diskSize size of the disk in megabytes
+     * @param options options to mount the file system with
+     * @return true if the file read back matches the written one
+     */
+    bool benchmarkFormat(const std::string& fileName, const std::size_t diskSize, const pfs::MountOptions& options) {
+        std::filesystem::remove(fileName);
+        std::string sample(SAMPLE_FILE_SIZE, '\0');
+        for (std::size_t i = 0; i < sample.size(); ++i) {
+            sample[i] = static_cast<char>(i * 31 + i / 4096);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        fs::Superblock superblock(diskSize);
+        double formatMs, writeMs, flushMs;
+        {
+            FileSystem fileSystem(fileName, options);
+            if (!fileSystem.initialize(superblock)) {
+                std::cout << "Formatting " << diskSize << " MB failed\n";
+                return false;
+            }
+            formatMs = elapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            fileSystem.createFile("/sample.bin", fs::FileData(sample));
+            writeMs = elapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+        }
+        flushMs = elapsedMs(start);
+
+        start = std::chrono::steady_clock::now();
+        FileSystem fileSystem(fileName, options);
+        double mountMs = elapsedMs(start);
+        if (!fileSystem.isInitialized()) {
+            std::cout << "Mounting " << diskSize << " MB failed\n";
+            return false;
+        }
+
+        start = std::chrono::steady_clock::now();
+        bool matches = fileSystem.getFileContent("/sample.bin") == sample;
+        double readMs = elapsedMs(start);
+
+        std::cout << diskSize << " MB - Clusters: " << superblock.getClusterCount() << " - I-nodes: "
+                  << superblock.getInodeCount() << " - Format: " << formatMs << " ms - Write: " << writeMs
+                  << " ms - Flush: " << flushMs << " ms - Mount: " << mountMs << " ms - Read: " << readMs
+                  << " ms - Allocated: " << allocatedBytes(fileName) / 1000 << " kB - "
+                  << (matches ? "OK" : "DATA MISMATCH") << '\n';
+        return matches;
+    }
+}
+
+/**
+ * Benchmark of formatting big file systems. Usage: format_bench <directory> [disk size in MB...] [mount options...]
+ * Data files are created in given directory and removed in the end.
+ */
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cout << "Usage: " << argv[0] << " <directory> [disk size in MB...] [mount options...]\n";
+        return EXIT_FAILURE;
+    }
+
+    std::vector<std::size_t> diskSizes;
+    pfs::MountOptions options;
+    for (int i = 2; i < argc; ++i) {
+        ConversionResult result = StringNumberConverter::convertStringToInt(argv[i]);
+        if (result.success && result.value > 0) {
+            diskSizes.push_back(result.value);
+        } else if (!options.parseOption(argv[i])) {
+            std::cout << "Invalid argument \"" << argv[i] << "\" passed!\n";
+            return EXIT_FAILURE;
+        }
+    }
+    if (diskSizes.empty()) {
+        diskSizes = DEFAULT_DISK_SIZES;
+    }
+
+    bool success = true;
+    const std::string fileName = (std::filesystem::path(argv[1]) / "format_bench.dat").string();
+    for (std::size_t diskSize : diskSizes) {
+        success = benchmarkFormat(fileName, diskSize, options) && success;
+    }
+    std::filesystem::remove(fileName);
+
+    return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
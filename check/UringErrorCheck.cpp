@@ -0,0 +1,87 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "../src/common/structures.h"
+#include "../src/fs/UringBlockDevice.h"
+
+namespace {
+
+    /// Data file created by the check
+    const std::string DATA_FILE_NAME = "uring_check.dat";
+    /// Seconds after which a batch that didn't return is considered hung
+    constexpr unsigned TIMEOUT_SECONDS = 10;
+
+    /**
+     * Device whose descriptor can be replaced by a directory, so every request submitted afterwards fails.
+     */
+    class BrokenUringBlockDevice : public pfs::UringBlockDevice {
+    public: // public methods
+        using pfs::UringBlockDevice::UringBlockDevice;
+
+        /// Replaces the descriptor of the data file by a descriptor of a directory
+        bool breakDescriptor() {
+            int directory = ::open("/", O_RDONLY | O_DIRECTORY);
+            if (directory < 0) {
+                return false;
+            }
+            bool replaced = ::dup2(directory, m_fd) >= 0;
+            ::close(directory);
+            return replaced;
+        }
+    };
+
+    /// Terminates the check when a batch hangs
+    void onTimeout(int) {
+        const char message[] = "Batch did not return after an I/O error\n";
+        ::write(STDERR_FILENO, message, sizeof(message) - 1);
+        std::_Exit(1);
+    }
+}
+
+/**
+ * Checks that a batch of more runs than fit into the queue returns with an error, instead of hanging, when it's
+ * requests fail. The check passes when the batch throws std::ios_base::failure in time.
+ */
+int main() {
+    std::signal(SIGALRM, onTimeout);
+    std::filesystem::remove(DATA_FILE_NAME);
+
+    /// Every other cluster is read, so the requests are not merged and most of them wait for a free queue entry
+    constexpr std::size_t runCount = 4 * pfs::UringBlockDevice::QUEUE_DEPTH;
+    std::vector<char> buffer(runCount * fs::Superblock::CLUSTER_SIZE);
+    std::vector<pfs::ReadRequest> requests;
+    for (std::size_t run = 0; run < runCount; ++run) {
+        requests.push_back({ 2 * run * fs::Superblock::CLUSTER_SIZE, buffer.data() + run * fs::Superblock::CLUSTER_SIZE,
+                             fs::Superblock::CLUSTER_SIZE });
+    }
+
+    int result = 1;
+    {
+        BrokenUringBlockDevice device(DATA_FILE_NAME, true, 2 * runCount * fs::Superblock::CLUSTER_SIZE);
+        if (!device.breakDescriptor()) {
+            std::cout << "Descriptor of the data file could not be replaced\n";
+        } else {
+            ::alarm(TIMEOUT_SECONDS);
+            try {
+                device.readBatch(requests);
+                std::cout << "Batch with failed requests did not report an error\n";
+            } catch (const std::ios_base::failure& ex) {
+                std::cout << "Batch failed as expected: " << ex.what() << '\n';
+                result = 0;
+            }
+            ::alarm(0);
+        }
+    }
+
+    std::filesystem::remove(DATA_FILE_NAME);
+    return result;
+}
@@ -7,8 +7,8 @@
 #include <filesystem>
 #include "PrimitiveFsApp.h"
 
-PrimitiveFsApp::PrimitiveFsApp(const std::string& fileName) {
-    m_fileSystem = new FileSystem(fileName);
+PrimitiveFsApp::PrimitiveFsApp(const std::string& fileName, const pfs::MountOptions& options) {
+    m_fileSystem = new FileSystem(fileName, options);
 }
 
 PrimitiveFsApp::~PrimitiveFsApp() {
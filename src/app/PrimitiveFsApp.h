@@ -31,8 +31,11 @@ public: //public methods
      * If file with given name doesn't exist, creates it in relative path to the executable.
      * If file with given name already exists, assumes that it is valid file for file system representation
      * created by this constructor.
+     *
+     * @param fileName name of the file representing the file system
+     * @param options options to mount the file system with
      */
-    explicit PrimitiveFsApp(const std::string& fileName);
+    PrimitiveFsApp(const std::string& fileName, const pfs::MountOptions& options);
     ~PrimitiveFsApp();
 
     /**
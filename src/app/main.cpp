@@ -18,10 +18,23 @@ int main(int argc, char** argv) {
         return InputParamsValidator::EXIT_INVALID_ARG_COUNT;
     }
 
+    /**
+     * Every other parameter is an option to mount the file system with.
+     */
+    pfs::MountOptions options;
+    for (int i = InputParamsValidator::REQUIRED_CLI_PARAMS_COUNT; i < argc; ++i) {
+        if (!options.parseOption(argv[i])) {
+            std::cout << "Invalid option \"" << argv[i] << "\" passed!\n"
+                         "Supported options: --io=mmap|pread|uring, --mapping=extents|links, --cache=<number of clusters>, "
+                         "--inode-cache=<number of i-nodes>, --dentry-cache=<number of directory items>\n";
+            return InputParamsValidator::EXIT_INVALID_OPTION;
+        }
+    }
+
     /**
      * We have valid arguments, we can run.
      */
-    PrimitiveFsApp application(argv[1]);
+    PrimitiveFsApp application(argv[1], options);
     application.run();
     return EXIT_SUCCESS;
 }
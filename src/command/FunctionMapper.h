@@ -38,7 +38,11 @@ private: //private attributes
             {"mv", &fnct::mv},
             {"load", &fnct::load},
             {"check", &fnct::check},
-            {"break", &fnct::breakData}
+            {"break", &fnct::breakData},
+            {"sync", &fnct::sync},
+            {"cachestat", &fnct::cachestat},
+            {"inodestat", &fnct::inodestat},
+            {"dentrystat", &fnct::dentrystat}
     };
 public: //public methods
 
@@ -54,22 +54,13 @@ void fnct::incp(const std::vector<std::string> &parameters, FileSystem* fileSyst
         return;
     }
 
-    const auto fileSize = std::filesystem::file_size(hddPath);
-    char fileBuffer[fileSize];
-    hddFile.read((char*)fileBuffer, fileSize);
-    std::string fileData;
-    for (const auto &c : fileBuffer) {
-        fileData += c;
-    }
-    /// Adding null termination character, so we can simply work with dynamic strings
-    /// Null termination character will be removed when saving into the data file
+    /// File is streamed into the file system, so it's never held in the memory whole
     try {
-        fileSystem->createFile(parameters.at(1), fs::FileData(fileData));
+        fileSystem->createFileFromStream(parameters.at(1), hddFile, std::filesystem::file_size(hddPath));
         std::cout << fnct::OK << '\n';
     } catch (const std::exception& ex) {
         std::cout << ex.what() << '\n';
     }
-
 }
 
 void fnct::pwd(const std::vector<std::string> &parameters, FileSystem *fileSystem) {
@@ -111,21 +102,18 @@ void fnct::ls(const std::vector<std::string> &parameters, FileSystem *fileSystem
         return;
     }
 
-    std::vector<fs::DirectoryItem> dirItems;
+    pfs::DirectoryCursor cursor;
     try {
-         dirItems = fileSystem->getDirectoryItems(parameters.at(0));
+        cursor = fileSystem->openDirectory(parameters.at(0));
     } catch (const std::exception &ex) {
         std::cout << fnct::PNF_DIR << '\n';
         return;
     }
 
-    for (const auto &dirItem : dirItems) {
-        char mark;
-        if (fileSystem->findInode(dirItem.getInodeId()).isDirectory()) {
-            mark = '+';
-        } else {
-            mark = '-';
-        }
+    /// Items are printed as the clusters of the directory are read, type is stored in the item so no i-node is read
+    fs::DirectoryItem dirItem;
+    while (cursor.next(dirItem)) {
+        char mark = dirItem.isDirectory() ? '+' : '-';
         std::cout << mark << dirItem.getItemName().data() << '\n';
     }
 }
@@ -373,4 +361,47 @@ void fnct::breakData(const std::vector<std::string> &parameters, FileSystem *fil
     }
 
     fileSystem->breakData();
+}
+
+void fnct::sync(const std::vector<std::string> &parameters, FileSystem *fileSystem) {
+    if (fileSystem == nullptr || !fileSystem->isInitialized()) {
+        std::cout << "File system is not initialized!\n";
+        return;
+    }
+
+    try {
+        fileSystem->sync();
+    } catch (const std::exception &ex) {
+        std::cout << ex.what() << '\n';
+        return;
+    }
+
+    std::cout << fnct::OK << '\n';
+}
+
+void fnct::cachestat(const std::vector<std::string> &parameters, FileSystem *fileSystem) {
+    if (fileSystem == nullptr || !fileSystem->isInitialized()) {
+        std::cout << "File system is not initialized!\n";
+        return;
+    }
+
+    fileSystem->printCacheStatistics();
+}
+
+void fnct::inodestat(const std::vector<std::string> &parameters, FileSystem *fileSystem) {
+    if (fileSystem == nullptr || !fileSystem->isInitialized()) {
+        std::cout << "File system is not initialized!\n";
+        return;
+    }
+
+    fileSystem->printInodeCacheStatistics();
+}
+
+void fnct::dentrystat(const std::vector<std::string> &parameters, FileSystem *fileSystem) {
+    if (fileSystem == nullptr || !fileSystem->isInitialized()) {
+        std::cout << "File system is not initialized!\n";
+        return;
+    }
+
+    fileSystem->printDentryCacheStatistics();
 }
\ No newline at end of file
@@ -136,5 +136,37 @@ namespace fnct {
      * @param fileSystem file system to break
      */
     void breakData(const std::vector<std::string> &parameters, FileSystem* fileSystem);
+
+    /**
+     * Writes all cached data of the file system into it's data file.
+     *
+     * @param parameters requires no parameters, none of given parameters will be used
+     * @param fileSystem file system to synchronize
+     */
+    void sync(const std::vector<std::string> &parameters, FileSystem* fileSystem);
+
+    /**
+     * Prints hit and miss statistics of the buffer cache.
+     *
+     * @param parameters requires no parameters, none of given parameters will be used
+     * @param fileSystem file system to print cache statistics of
+     */
+    void cachestat(const std::vector<std::string> &parameters, FileSystem* fileSystem);
+
+    /**
+     * Prints hit and miss statistics of the i-node cache.
+     *
+     * @param parameters requires no parameters, none of given parameters will be used
+     * @param fileSystem file system to print i-node cache statistics of
+     */
+    void inodestat(const std::vector<std::string> &parameters, FileSystem* fileSystem);
+
+    /**
+     * Prints hit and miss statistics of the dentry cache.
+     *
+     * @param parameters requires no parameters, none of given parameters will be used
+     * @param fileSystem file system to print dentry cache statistics of
+     */
+    void dentrystat(const std::vector<std::string> &parameters, FileSystem* fileSystem);
 }
 #endif //PRIMITIVE_FS_FUNCTION_H
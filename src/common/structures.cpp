@@ -2,31 +2,100 @@
 // Author: markovd@students.zcu.cz
 //
 
+#include <algorithm>
 #include <iostream>
 #include "structures.h"
+#include "../fs/BlockDevice.h"
+
+namespace {
+    /**
+     * Loads eight bytes of a bitmap as one word, so that the first index stored in them is the most significant bit.
+     */
+    uint64_t loadBitmapWord(const u_char* bytes) {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        if constexpr (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+            word = __builtin_bswap64(word);
+        }
+        return word;
+    }
+
+    /**
+     * Walks a link tree of given depth in the list of data blocks ordered the way they are linked, starting at given
+     * position, and moves the position behind the tree. Blocks holding links are marked in given mask, if any.
+     */
+    void walkLinkTree(const size_t depth, size_t& position, const size_t blockCount, std::vector<bool>* indirect) {
+        if (position >= blockCount) {
+            return;
+        }
+        if (depth == 0) {
+            position++;
+            return;
+        }
+
+        if (indirect != nullptr) {
+            (*indirect)[position] = true;
+        }
+        position++;
+        for (size_t link = 0; link < fs::Inode::LINKS_IN_INDIRECT && position < blockCount; ++link) {
+            walkLinkTree(depth - 1, position, blockCount, indirect);
+        }
+    }
+}
 
 namespace fs {
 
+    void encodeInt32(u_char *bytes, const int32_t value) {
+        auto bits = static_cast<uint32_t>(value);
+        for (size_t i = 0; i < sizeof(bits); ++i) {
+            bytes[i] = static_cast<u_char>(bits >> (8 * i));
+        }
+    }
+
+    int32_t decodeInt32(const u_char *bytes) {
+        uint32_t bits = 0;
+        for (size_t i = 0; i < sizeof(bits); ++i) {
+            bits |= static_cast<uint32_t>(bytes[i]) << (8 * i);
+        }
+        return static_cast<int32_t>(bits);
+    }
+
+    void encodeInt64(u_char *bytes, const int64_t value) {
+        auto bits = static_cast<uint64_t>(value);
+        for (size_t i = 0; i < sizeof(bits); ++i) {
+            bytes[i] = static_cast<u_char>(bits >> (8 * i));
+        }
+    }
+
+    int64_t decodeInt64(const u_char *bytes) {
+        uint64_t bits = 0;
+        for (size_t i = 0; i < sizeof(bits); ++i) {
+            bits |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+        }
+        return static_cast<int64_t>(bits);
+    }
+
     Superblock::Superblock(const size_t newDiskSize) : m_signature(), m_volumeDescription() {
-        if (newDiskSize > 1000 || newDiskSize < 2) {
-            std::cout << "Prosím, zadejte velikost disku mezi 2 a 1000 MB!";
+        if (newDiskSize > MAX_DISK_SIZE_MB || newDiskSize < MIN_DISK_SIZE_MB) {
+            std::cout << "Prosím, zadejte velikost disku mezi " << MIN_DISK_SIZE_MB << " a " << MAX_DISK_SIZE_MB << " MB!";
             return;
         }
+        m_formatVersion = FORMAT_VERSION;
         strncpy(m_signature.data(), AUTHOR_NAME, SIGNATURE_LENGTH);
         strncpy(m_volumeDescription.data(), VOLUME_DESCRIPTION, VOLUME_DESC_LENGTH);
         /**
          * Converting passed size in megabytes to bytes.
          */
-        m_diskSize = newDiskSize * 1000000;
+        m_diskSize = static_cast<int64_t>(newDiskSize) * 1000000;
         /**
          * Setting the i-node count to 1/1000 of the disk size
          */
         m_inodeCount = m_diskSize / 1000;
-        m_inodeBitmapStartAddress = sizeof(Superblock);
+        m_inodeBitmapStartAddress = DISK_SIZE;
         m_dataBitmapStartAddress = m_inodeBitmapStartAddress +
                 ((m_inodeCount % 8 == 0) ? (m_inodeCount / 8) : ((m_inodeCount / 8) + 1));
 
-        size_t inodeStorageSize = m_inodeCount * sizeof(Inode);
+        size_t inodeStorageSize = m_inodeCount * Inode::DISK_SIZE;
         /**
          * Size of storage for data-block bitmap and blocks themselves.
          */
@@ -46,6 +115,10 @@ namespace fs {
         m_inodeStartAddress = m_dataBitmapStartAddress +
                 ((m_clusterCount % 8 == 0) ? (m_clusterCount / 8) : ((m_clusterCount / 8) + 1));
         m_dataStartAddress = m_inodeStartAddress + inodeStorageSize;
+        /**
+         * Only the cluster of the root directory is written during format, the rest of the data file is left sparse.
+         */
+        m_initializedClusterCount = 1;
     }
 
     const std::array<char, Superblock::SIGNATURE_LENGTH> &Superblock::getSignature() const {
@@ -56,73 +129,105 @@ namespace fs {
         return m_volumeDescription;
     }
 
-    int32_t Superblock::getDiskSize() const {
+    int32_t Superblock::getFormatVersion() const {
+        return m_formatVersion;
+    }
+
+    int64_t Superblock::getDiskSize() const {
         return m_diskSize;
     }
 
-    int32_t Superblock::getClusterCount() const {
+    int64_t Superblock::getClusterCount() const {
         return m_clusterCount;
     }
 
-    int32_t Superblock::getInodeBitmapStartAddress() const {
+    int64_t Superblock::getInodeBitmapStartAddress() const {
         return m_inodeBitmapStartAddress;
     }
 
-    int32_t Superblock::getDataBitmapStartAddress() const {
+    int64_t Superblock::getDataBitmapStartAddress() const {
         return m_dataBitmapStartAddress;
     }
 
-    int32_t Superblock::getInodeStartAddress() const {
+    int64_t Superblock::getInodeStartAddress() const {
         return m_inodeStartAddress;
     }
 
-    int32_t Superblock::getDataStartAddress() const {
+    int64_t Superblock::getDataStartAddress() const {
         return m_dataStartAddress;
     }
 
-    int32_t Superblock::getInodeCount() const {
+    int64_t Superblock::getInodeCount() const {
         return m_inodeCount;
     }
 
-    void Superblock::load(std::ifstream &dataFile, const size_t address) {
-        if (!dataFile.is_open()) {
-            throw std::invalid_argument("Předaný datový soubor není otevřen ke čtení");
-        }
+    int64_t Superblock::getInitializedClusterCount() const {
+        return m_initializedClusterCount;
+    }
+
+    int32_t Superblock::getGroupCount() const {
+        auto groupCount = static_cast<int32_t>((m_clusterCount + CLUSTERS_PER_GROUP - 1) / CLUSTERS_PER_GROUP);
+        return std::max(groupCount, 1);
+    }
+
+    int32_t Superblock::getInodesPerGroup() const {
+        auto inodesPerGroup = static_cast<int32_t>((m_inodeCount + getGroupCount() - 1) / getGroupCount());
+        /// Groups have to start at a whole byte of the bitmap
+        return ((inodesPerGroup + 7) / 8) * 8;
+    }
+
+    int32_t Superblock::getInodeGroupCount() const {
+        auto inodeGroupCount = static_cast<int32_t>((m_inodeCount + getInodesPerGroup() - 1) / getInodesPerGroup());
+        return std::max(inodeGroupCount, 1);
+    }
 
-        dataFile.seekg(address, std::ios_base::beg);
-        dataFile.read(m_signature.data(), SIGNATURE_LENGTH);
-        dataFile.read(m_volumeDescription.data(), VOLUME_DESC_LENGTH);
-        dataFile.read((char*)&m_diskSize, sizeof(m_diskSize));
-        dataFile.read((char*)&m_inodeCount, sizeof(m_inodeCount));
-        dataFile.read((char*)&m_clusterCount, sizeof(m_clusterCount));
-        dataFile.read((char*)&m_inodeBitmapStartAddress, sizeof(m_inodeBitmapStartAddress));
-        dataFile.read((char*)&m_dataBitmapStartAddress, sizeof(m_dataBitmapStartAddress));
-        dataFile.read((char*)&m_inodeStartAddress, sizeof(m_inodeStartAddress));
-        dataFile.read((char*)&m_dataStartAddress, sizeof(m_dataStartAddress));
+    int32_t Superblock::getInodeGroup(const int32_t inodeId) const {
+        return inodeId / getInodesPerGroup();
     }
 
-    void Superblock::save(std::fstream &dataFile, const size_t address) const {
-        if (!dataFile.is_open()) {
-            throw std::invalid_argument("Předaný datový soubor není otevřen k zápisu");
+    void Superblock::load(const pfs::BlockDevice &device, const size_t address) {
+        std::array<u_char, DISK_SIZE> record {};
+        device.read(address, record.data(), record.size());
+
+        u_char* field = record.data();
+        memcpy(m_signature.data(), field, SIGNATURE_LENGTH);
+        field += SIGNATURE_LENGTH;
+        memcpy(m_volumeDescription.data(), field, VOLUME_DESC_LENGTH);
+        field += VOLUME_DESC_LENGTH;
+        m_formatVersion = decodeInt32(field);
+        field += sizeof(int32_t);
+        for (int64_t* value : {&m_diskSize, &m_inodeCount, &m_clusterCount, &m_inodeBitmapStartAddress,
+                               &m_dataBitmapStartAddress, &m_inodeStartAddress, &m_dataStartAddress,
+                               &m_initializedClusterCount}) {
+            *value = decodeInt64(field);
+            field += sizeof(int64_t);
         }
+    }
 
-        dataFile.seekp(address, std::ios_base::beg);
-        dataFile.write(m_signature.data(), SIGNATURE_LENGTH);
-        dataFile.write(m_volumeDescription.data(), VOLUME_DESC_LENGTH);
-        dataFile.write((char*)&m_diskSize, sizeof(m_diskSize));
-        dataFile.write((char*)&m_inodeCount, sizeof(m_inodeCount));
-        dataFile.write((char*)&m_clusterCount, sizeof(m_clusterCount));
-        dataFile.write((char*)&m_inodeBitmapStartAddress, sizeof(m_inodeBitmapStartAddress));
-        dataFile.write((char*)&m_dataBitmapStartAddress, sizeof(m_dataBitmapStartAddress));
-        dataFile.write((char*)&m_inodeStartAddress, sizeof(m_inodeStartAddress));
-        dataFile.write((char*)&m_dataStartAddress, sizeof(m_dataStartAddress));
-        dataFile.flush();
+    void Superblock::save(pfs::BlockDevice &device, const size_t address) const {
+        std::array<u_char, DISK_SIZE> record {};
+        u_char* field = record.data();
+        memcpy(field, m_signature.data(), SIGNATURE_LENGTH);
+        field += SIGNATURE_LENGTH;
+        memcpy(field, m_volumeDescription.data(), VOLUME_DESC_LENGTH);
+        field += VOLUME_DESC_LENGTH;
+        encodeInt32(field, m_formatVersion);
+        field += sizeof(int32_t);
+        for (int64_t value : {m_diskSize, m_inodeCount, m_clusterCount, m_inodeBitmapStartAddress,
+                              m_dataBitmapStartAddress, m_inodeStartAddress, m_dataStartAddress,
+                              m_initializedClusterCount}) {
+            encodeInt64(field, value);
+            field += sizeof(int64_t);
+        }
+
+        device.write(address, record.data(), record.size());
     }
 
 
-    DirectoryItem::DirectoryItem(const std::string &itemName, const int32_t inodeId) : m_inodeId(inodeId), m_itemName(){
-        if (itemName.length() > 12) {
-            strncpy(this->m_itemName.data(), itemName.c_str(), DIR_ITEM_NAME_LENGTH);
+    DirectoryItem::DirectoryItem(const std::string &itemName, const int32_t inodeId, const FileType fileType)
+        : m_inodeId(inodeId), m_itemName(), m_fileType(fileType) {
+        if (itemName.length() > MAX_NAME_LENGTH) {
+            strncpy(this->m_itemName.data(), itemName.c_str(), MAX_NAME_LENGTH);
         } else {
             strncpy(this->m_itemName.data(), itemName.c_str(), itemName.length());
         }
@@ -136,6 +241,14 @@ namespace fs {
         return m_itemName;
     }
 
+    FileType DirectoryItem::getFileType() const {
+        return m_fileType;
+    }
+
+    bool DirectoryItem::isDirectory() const {
+        return m_fileType == FileType::DIRECTORY;
+    }
+
     bool DirectoryItem::nameEquals(const std::string &name) const {
         if (name.length() != getItemNameLength()) {
             return false;
@@ -153,31 +266,180 @@ namespace fs {
         return DIR_ITEM_NAME_LENGTH;
     }
 
-    void DirectoryItem::save(std::fstream &dataFile, size_t address) const {
-        if (!dataFile.is_open()) {
-            throw std::invalid_argument("Předaný datový soubor není otevřený k zápisu");
+    bool DirectoryItem::isFree() const {
+        return m_itemName[0] == '\0';
+    }
+
+    uint32_t DirectoryItem::getNameHash() const {
+        return hashName(std::string(m_itemName.data(), getItemNameLength()));
+    }
+
+    void DirectoryItem::save(pfs::BlockDevice &device, const size_t address) const {
+        std::array<u_char, DISK_SIZE> record {};
+        encode(record.data());
+
+        device.write(address, record.data(), record.size());
+    }
+
+    void DirectoryItem::load(const pfs::BlockDevice &device, const size_t address) {
+        std::array<u_char, DISK_SIZE> record {};
+        device.read(address, record.data(), record.size());
+
+        decode(record.data());
+    }
+
+    void DirectoryItem::encode(u_char *record) const {
+        encodeInt32(record, m_inodeId);
+        memcpy(record + sizeof(int32_t), m_itemName.data(), MAX_NAME_LENGTH);
+        /// Type takes the place of the terminating zero of the longest names
+        record[sizeof(int32_t) + MAX_NAME_LENGTH] = static_cast<u_char>(m_fileType);
+    }
+
+    void DirectoryItem::decode(const u_char *record) {
+        m_inodeId = decodeInt32(record);
+        memcpy(m_itemName.data(), record + sizeof(int32_t), MAX_NAME_LENGTH);
+        m_itemName[MAX_NAME_LENGTH] = '\0';
+        m_fileType = static_cast<FileType>(record[sizeof(int32_t) + MAX_NAME_LENGTH]);
+    }
+
+    uint32_t hashName(const std::string &name) {
+        /// FNV-1a, spreading even names differing in one character
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < std::min(name.length(), DirectoryItem::MAX_NAME_LENGTH) && name[i] != '\0'; ++i) {
+            hash ^= static_cast<u_char>(name[i]);
+            hash *= 16777619u;
         }
+        return hash;
+    }
+
+    int32_t DirectoryHeader::getGlobalDepth() const {
+        return m_globalDepth;
+    }
+
+    int32_t DirectoryHeader::getBucketCount() const {
+        return m_bucketCount;
+    }
+
+    int32_t DirectoryHeader::getItemCount() const {
+        return m_itemCount;
+    }
 
-        dataFile.seekp(address, std::ios_base::beg);
-        dataFile.write((char*)&m_inodeId, sizeof(m_inodeId));
-        dataFile.write(m_itemName.data(), m_itemName.size());
-        dataFile.flush();
+    const std::vector<int32_t> &DirectoryHeader::getTableLinks() const {
+        return m_tableLinks;
     }
 
-    void DirectoryItem::load(std::ifstream &dataFile, size_t address) {
-        if (!dataFile.is_open()) {
-            throw std::invalid_argument("Předaný datový soubor není otevřený ke čtení");
+    size_t DirectoryHeader::getTableSize() const {
+        return size_t(1) << m_globalDepth;
+    }
+
+    size_t DirectoryHeader::getTableEntry(const uint32_t hash) const {
+        return hash & (getTableSize() - 1);
+    }
+
+    void DirectoryHeader::setGlobalDepth(const int32_t globalDepth) {
+        m_globalDepth = globalDepth;
+    }
+
+    void DirectoryHeader::setBucketCount(const int32_t bucketCount) {
+        m_bucketCount = bucketCount;
+    }
+
+    void DirectoryHeader::setItemCount(const int32_t itemCount) {
+        m_itemCount = itemCount;
+    }
+
+    void DirectoryHeader::setTableLinks(const std::vector<int32_t> &tableLinks) {
+        m_tableLinks = tableLinks;
+    }
+
+    void DirectoryHeader::encode(u_char *cluster) const {
+        u_char* field = cluster + OFFSET;
+        for (int32_t value : {m_globalDepth, m_bucketCount, m_itemCount}) {
+            encodeInt32(field, value);
+            field += sizeof(int32_t);
+        }
+        for (int32_t link : m_tableLinks) {
+            encodeInt32(field, link);
+            field += sizeof(int32_t);
+        }
+    }
+
+    void DirectoryHeader::decode(const u_char *cluster) {
+        const u_char* field = cluster + OFFSET;
+        for (int32_t* value : {&m_globalDepth, &m_bucketCount, &m_itemCount}) {
+            *value = decodeInt32(field);
+            field += sizeof(int32_t);
         }
+        m_globalDepth = std::clamp(m_globalDepth, 0, MAX_DEPTH);
+        /// Directory without buckets has no table either
+        size_t tableClusters = (m_bucketCount > 0)
+                ? (getTableSize() + ENTRIES_IN_TABLE_CLUSTER - 1) / ENTRIES_IN_TABLE_CLUSTER : 0;
+        m_tableLinks.resize(tableClusters);
+        for (int32_t& link : m_tableLinks) {
+            link = decodeInt32(field);
+            field += sizeof(int32_t);
+        }
+    }
 
-        dataFile.seekg(address, std::ios_base::beg);
-        dataFile.read((char*)&m_inodeId, sizeof(m_inodeId));
-        dataFile.read((char*)m_itemName.data(), m_itemName.size());
+    int32_t DirectoryBucket::getLocalDepth() const {
+        return m_localDepth;
+    }
+
+    void DirectoryBucket::setLocalDepth(const int32_t localDepth) {
+        m_localDepth = localDepth;
+    }
+
+    const std::array<DirectoryItem, DirectoryBucket::ITEM_COUNT> &DirectoryBucket::getItems() const {
+        return m_items;
+    }
+
+    size_t DirectoryBucket::findItem(const std::string &name) const {
+        for (size_t slot = 0; slot < m_items.size(); ++slot) {
+            if (m_items[slot].nameEquals(name)) {
+                return slot;
+            }
+        }
+        return ITEM_COUNT;
+    }
+
+    std::bitset<DirectoryBucket::ITEM_COUNT> DirectoryBucket::getUsedSlots() const {
+        std::bitset<ITEM_COUNT> usedSlots;
+        for (size_t slot = 0; slot < m_items.size(); ++slot) {
+            usedSlots[slot] = !m_items[slot].isFree();
+        }
+        return usedSlots;
+    }
+
+    void DirectoryBucket::setItem(const size_t slot, const DirectoryItem &item) {
+        m_items.at(slot) = item;
+    }
+
+    size_t DirectoryBucket::getSlotOffset(const size_t slot) {
+        /// The first slot of the cluster holds the local depth
+        return (slot + 1) * DirectoryItem::DISK_SIZE;
+    }
+
+    void DirectoryBucket::encode(u_char *cluster) const {
+        memset(cluster, 0, Superblock::CLUSTER_SIZE);
+        encodeInt32(cluster, m_localDepth);
+        for (size_t slot = 0; slot < m_items.size(); ++slot) {
+            if (!m_items[slot].isFree()) {
+                m_items[slot].encode(cluster + getSlotOffset(slot));
+            }
+        }
+    }
+
+    void DirectoryBucket::decode(const u_char *cluster) {
+        m_localDepth = decodeInt32(cluster);
+        for (size_t slot = 0; slot < m_items.size(); ++slot) {
+            m_items[slot].decode(cluster + getSlotOffset(slot));
+        }
     }
 
     Inode::Inode() {
         init();
     }
-    Inode::Inode(int32_t nodeId, bool isDirectory, int32_t fileSize) : m_inodeId(nodeId), m_isDirectory(isDirectory),
+    Inode::Inode(int32_t nodeId, bool isDirectory, int64_t fileSize) : m_inodeId(nodeId), m_isDirectory(isDirectory),
                                                                        m_fileSize(fileSize){
         init();
     }
@@ -206,13 +468,21 @@ namespace fs {
         m_references = references;
     }
 
-    int32_t Inode::getFileSize() const {
+    int64_t Inode::getFileSize() const {
         return m_fileSize;
     }
 
-    void Inode::setFileSize(int32_t fileSize) {
+    void Inode::setFileSize(int64_t fileSize) {
         m_fileSize = fileSize;
     }
+
+    int32_t Inode::getParentId() const {
+        return m_parentId;
+    }
+
+    void Inode::setParentId(int32_t parentId) {
+        m_parentId = parentId;
+    }
     const std::array<int32_t, Inode::DIRECT_LINKS_COUNT> &Inode::getDirectLinks() const {
         return m_directLinks;
     }
@@ -262,33 +532,87 @@ namespace fs {
         return container.size();
     }
 
-    void Inode::save(std::fstream &dataFile, size_t address) const {
-        if (!dataFile) {
-            throw std::invalid_argument("Předaný datový soubor není otevřen k zápisu");
-        }
+    void Inode::save(pfs::BlockDevice &device, const size_t address) const {
+        std::array<u_char, DISK_SIZE> record {};
+        encode(record.data());
+        device.write(address, record.data(), record.size());
+    }
 
-        dataFile.seekp(address, std::ios_base::beg);
-        dataFile.write((char*)&m_inodeId, sizeof(m_inodeId));
-        dataFile.write((char*)&m_isDirectory, sizeof(m_isDirectory));
-        dataFile.write((char*)&m_references, sizeof(m_references));
-        dataFile.write((char*)&m_fileSize, sizeof(m_fileSize));
-        dataFile.write((char*)m_directLinks.data(), (m_directLinks.size() * sizeof(int32_t)));
-        dataFile.write((char*)m_indirectLinks.data(), (m_indirectLinks.size() * sizeof(int32_t)));
-        dataFile.flush();
+    void Inode::load(const pfs::BlockDevice &device, const size_t address) {
+        std::array<u_char, DISK_SIZE> record {};
+        device.read(address, record.data(), record.size());
+        decode(record.data());
     }
 
-    void Inode::load(std::ifstream &dataFile, size_t address) {
-        if (!dataFile) {
-            throw std::invalid_argument("Předaný datový soubor není otevřen ke čtení");
+    void Inode::encode(u_char *record) const {
+        encodeInt32(record, m_inodeId);
+        record += sizeof(int32_t);
+        *(record++) = (m_isDirectory ? DIRECTORY_FLAG : 0) | (m_usesExtents ? EXTENTS_FLAG : 0)
+                | (m_hasInlineData ? INLINE_DATA_FLAG : 0);
+        *(record++) = static_cast<u_char>(m_references);
+        encodeInt64(record, m_fileSize);
+        record += sizeof(int64_t);
+        encodeInt32(record, m_parentId);
+        record += sizeof(int32_t);
+        if (m_hasInlineData) {
+            /// Data take the place of the links
+            memcpy(record, m_inlineData.data(), m_inlineData.size());
+            return;
+        }
+        if (m_usesExtents) {
+            /// Extents take the place of the links
+            for (const Extent& extent : m_extents) {
+                encodeInt32(record, extent.start);
+                encodeInt32(record + sizeof(int32_t), extent.length);
+                record += sizeof(Extent);
+            }
+            encodeInt32(record, m_extentTreeLink);
+            return;
         }
+        for (int32_t link : m_directLinks) {
+            encodeInt32(record, link);
+            record += sizeof(int32_t);
+        }
+        for (int32_t link : {m_indirectLinks[0], m_indirectLinks[1], m_doubleIndirectLink, m_tripleIndirectLink}) {
+            encodeInt32(record, link);
+            record += sizeof(int32_t);
+        }
+    }
 
-        dataFile.seekg(address, std::ios_base::beg);
-        dataFile.read((char*)&m_inodeId, sizeof(m_inodeId));
-        dataFile.read((char*)&m_isDirectory, sizeof(m_isDirectory));
-        dataFile.read((char*)&m_references, sizeof(m_references));
-        dataFile.read((char*)&m_fileSize, sizeof(m_fileSize));
-        dataFile.read((char*)m_directLinks.data(), (m_directLinks.size() * sizeof(int32_t)));
-        dataFile.read((char*)m_indirectLinks.data(), (m_indirectLinks.size() * sizeof(int32_t)));
+    void Inode::decode(const u_char *record) {
+        m_inodeId = decodeInt32(record);
+        record += sizeof(int32_t);
+        u_char flags = *(record++);
+        m_isDirectory = (flags & DIRECTORY_FLAG) != 0;
+        m_usesExtents = (flags & EXTENTS_FLAG) != 0;
+        m_references = static_cast<int8_t>(*(record++));
+        m_fileSize = decodeInt64(record);
+        record += sizeof(int64_t);
+        m_parentId = decodeInt32(record);
+        record += sizeof(int32_t);
+        init();
+        if ((flags & INLINE_DATA_FLAG) != 0) {
+            m_hasInlineData = true;
+            memcpy(m_inlineData.data(), record, m_inlineData.size());
+            return;
+        }
+        if (m_usesExtents) {
+            for (Extent& extent : m_extents) {
+                extent.start = decodeInt32(record);
+                extent.length = decodeInt32(record + sizeof(int32_t));
+                record += sizeof(Extent);
+            }
+            m_extentTreeLink = decodeInt32(record);
+            return;
+        }
+        for (int32_t& link : m_directLinks) {
+            link = decodeInt32(record);
+            record += sizeof(int32_t);
+        }
+        for (int32_t* link : {&m_indirectLinks[0], &m_indirectLinks[1], &m_doubleIndirectLink, &m_tripleIndirectLink}) {
+            *link = decodeInt32(record);
+            record += sizeof(int32_t);
+        }
     }
 
     bool Inode::addDirectLink(int32_t address) {
@@ -316,8 +640,88 @@ namespace fs {
     }
 
     void Inode::setData(const DataLinks &dataLinks) {
+        init();
+        m_usesExtents = false;
         m_directLinks = dataLinks.getDirectLinks();
         m_indirectLinks = dataLinks.getIndirectLinks();
+        m_doubleIndirectLink = dataLinks.getDoubleIndirectLink();
+        m_tripleIndirectLink = dataLinks.getTripleIndirectLink();
+    }
+
+    int32_t Inode::getDoubleIndirectLink() const {
+        return m_doubleIndirectLink;
+    }
+
+    int32_t Inode::getTripleIndirectLink() const {
+        return m_tripleIndirectLink;
+    }
+
+    int32_t Inode::getTreeLink(const size_t tree) const {
+        if (tree < INDIRECT_LINKS_COUNT) {
+            return m_indirectLinks[tree];
+        }
+        return (tree == INDIRECT_LINKS_COUNT) ? m_doubleIndirectLink : m_tripleIndirectLink;
+    }
+
+    void Inode::setTreeLink(const size_t tree, const int32_t link) {
+        if (tree < INDIRECT_LINKS_COUNT) {
+            m_indirectLinks[tree] = link;
+        } else if (tree == INDIRECT_LINKS_COUNT) {
+            m_doubleIndirectLink = link;
+        } else {
+            m_tripleIndirectLink = link;
+        }
+    }
+
+    void Inode::setDirectLink(const size_t index, const int32_t link) {
+        m_directLinks.at(index) = link;
+    }
+
+    bool Inode::usesExtents() const {
+        return m_usesExtents;
+    }
+
+    const std::array<Extent, Inode::INLINE_EXTENTS_COUNT> &Inode::getInlineExtents() const {
+        return m_extents;
+    }
+
+    int32_t Inode::getExtentTreeLink() const {
+        return m_extentTreeLink;
+    }
+
+    void Inode::setExtents(const std::vector<Extent> &extents) {
+        if (extents.size() > m_extents.size()) {
+            throw std::invalid_argument("Do i-uzlu nelze uložit tolik extentů");
+        }
+
+        init();
+        m_usesExtents = true;
+        std::copy(extents.begin(), extents.end(), m_extents.begin());
+    }
+
+    void Inode::setExtentTree(const int32_t rootLink) {
+        init();
+        m_usesExtents = true;
+        m_extentTreeLink = rootLink;
+    }
+
+    bool Inode::hasInlineData() const {
+        return m_hasInlineData;
+    }
+
+    std::string Inode::getInlineData() const {
+        return std::string(m_inlineData.data(), std::clamp<int64_t>(m_fileSize, 0, m_inlineData.size()));
+    }
+
+    void Inode::setInlineData(const std::string &data) {
+        if (data.size() > m_inlineData.size()) {
+            throw std::invalid_argument("Do i-uzlu nelze uložit tolik dat");
+        }
+
+        init();
+        m_usesExtents = false;
+        m_hasInlineData = true;
+        std::copy(data.begin(), data.end(), m_inlineData.begin());
     }
 
     void Inode::clearDirectLink(const int32_t index) {
@@ -344,9 +748,261 @@ namespace fs {
         }
     }
 
+    void Bitmap::save(pfs::BlockDevice &device, const size_t address) {
+        std::vector<pfs::WriteRequest> writes;
+        for (const auto &[start, end] : m_dirtyRanges) {
+            if (!writes.empty() && start - (writes.back().address + writes.back().length - address) <= DIRTY_RANGE_GAP) {
+                /// Writing the few clean bytes in between is cheaper than another write
+                writes.back().length = end - (writes.back().address - address);
+            } else {
+                writes.push_back({ address + start, m_bitmap + start, end - start });
+            }
+        }
+
+        device.writeBatch(writes);
+        m_dirtyRanges.clear();
+    }
+
+    void Bitmap::load(const pfs::BlockDevice &device, const size_t address) {
+        device.read(address, m_bitmap, m_length);
+        m_dirtyRanges.clear();
+        rebuildSummary();
+    }
+
+    size_t Bitmap::getSuperwordFreeCount(const std::size_t superword) const {
+        return (superword < m_superwordFreeCounts.size()) ? m_superwordFreeCounts[superword] : 0;
+    }
+
+    std::vector<int32_t> Bitmap::findFreeIndexes(const std::size_t count) const {
+        std::vector<int32_t> freeIndexes;
+        if (count <= m_freeCount) {
+            /// Visiting only the words with a free index, every free bit is found by counting leading zeros
+            for (std::size_t word = findFreeWord(0); word < getWordCount(); word = findFreeWord(word + 1)) {
+                uint64_t freeBits = getFreeBits(word);
+                while (freeBits) {
+                    int bit = __builtin_clzll(freeBits);
+                    freeIndexes.push_back((word * INDEXES_IN_WORD) + bit);
+                    if (freeIndexes.size() == count) {
+                        return freeIndexes;
+                    }
+                    freeBits &= ~(1ULL << (INDEXES_IN_WORD - 1 - bit));
+                }
+            }
+        }
+
+        /// No free index found or not enough of free indexes
+        throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných indexů bitmapy");
+    }
+
+    std::vector<std::pair<std::size_t, std::size_t>> Bitmap::findFreeRuns(const std::size_t indexCount) const {
+        std::vector<std::pair<std::size_t, std::size_t>> runs;
+        for (std::size_t word = findFreeWord(0); word < getWordCount(); word = findFreeWord(word + 1)) {
+            uint64_t freeBits = getFreeBits(word);
+            while (freeBits) {
+                /// Run starts at the first free bit and ends in front of the next filled one
+                int start = __builtin_clzll(freeBits);
+                uint64_t shifted = ~(freeBits << start);
+                int length = shifted ? __builtin_clzll(shifted) : static_cast<int>(INDEXES_IN_WORD) - start;
+
+                std::size_t index = (word * INDEXES_IN_WORD) + start;
+                if (index >= indexCount) {
+                    return runs;
+                }
+                std::size_t runLength = std::min<std::size_t>(length, indexCount - index);
+                if (!runs.empty() && runs.back().first + runs.back().second == index) {
+                    /// Run continues from the previous word
+                    runs.back().second += runLength;
+                } else {
+                    runs.emplace_back(index, runLength);
+                }
+
+                freeBits = (start + length == INDEXES_IN_WORD) ? 0 : freeBits & (~0ULL >> (start + length));
+            }
+        }
+
+        return runs;
+    }
+
+    int32_t Bitmap::findFirstFreeIndex() const {
+        if (m_freeCount > 0) {
+            std::size_t word = findFreeWord(0);
+            if (word < getWordCount()) {
+                return (word * INDEXES_IN_WORD) + __builtin_clzll(getFreeBits(word));
+            }
+        }
+        /// If we get here, the bitmap is full
+        throw pfs::ObjectNotFound("Nenalezen žádný volný index v bitmapě");
+    }
+
+    void Bitmap::setIndexFilled(const std::size_t index) {
+        std::size_t bitmapIndex = index / 8;
+        if (bitmapIndex >= m_length) {
+            return;
+        }
+
+        u_char mask = 1U << (7 - (index % 8));
+        if (!(m_bitmap[bitmapIndex] & mask)) {
+            m_bitmap[bitmapIndex] |= mask;
+            m_freeCount--;
+            markDirty(bitmapIndex);
+
+            std::size_t word = index / INDEXES_IN_WORD;
+            m_superwordFreeCounts[word / WORDS_IN_SUPERWORD]--;
+            if (getFreeBits(word) == 0) {
+                updateSummary(word, false);
+            }
+        }
+    }
+
+    void Bitmap::setIndexFree(const std::size_t index) {
+        std::size_t bitmapIndex = index / 8;
+        if (bitmapIndex >= m_length) {
+            return;
+        }
+
+        u_char mask = 1U << (7 - (index % 8));
+        if (m_bitmap[bitmapIndex] & mask) {
+            m_bitmap[bitmapIndex] &= ~mask;
+            m_freeCount++;
+            markDirty(bitmapIndex);
+
+            std::size_t word = index / INDEXES_IN_WORD;
+            m_superwordFreeCounts[word / WORDS_IN_SUPERWORD]++;
+            updateSummary(word, true);
+        }
+    }
+
+    std::size_t Bitmap::getWordCount() const {
+        return (m_length + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+    }
+
+    uint64_t Bitmap::getFreeBits(const std::size_t word) const {
+        std::size_t start = word * sizeof(uint64_t);
+        if (start + sizeof(uint64_t) <= m_length) {
+            return ~loadBitmapWord(m_bitmap + start);
+        }
+
+        /// Bytes behind the end of the bitmap are treated as filled
+        std::array<u_char, sizeof(uint64_t)> bytes {};
+        bytes.fill(0xFF);
+        memcpy(bytes.data(), m_bitmap + start, m_length - start);
+        return ~loadBitmapWord(bytes.data());
+    }
+
+    std::size_t Bitmap::findFreeWord(const std::size_t word) const {
+        /// Going up the levels until a set bit at or behind the position is found
+        std::size_t level = 0;
+        std::size_t position = word;
+        while (true) {
+            if (level == m_summary.size()) {
+                return getWordCount();
+            }
+
+            std::size_t summaryWord = position / INDEXES_IN_WORD;
+            if (summaryWord >= m_summary[level].size()) {
+                return getWordCount();
+            }
+
+            uint64_t bits = m_summary[level][summaryWord] & (~0ULL << (position % INDEXES_IN_WORD));
+            if (bits) {
+                position = (summaryWord * INDEXES_IN_WORD) + __builtin_ctzll(bits);
+                break;
+            }
+
+            /// Nothing in this summary word, continuing with the next one on the level above
+            position = summaryWord + 1;
+            level++;
+        }
+
+        /// Going back down, always to the first set bit of the summary word found above
+        while (level > 0) {
+            level--;
+            position = (position * INDEXES_IN_WORD) + __builtin_ctzll(m_summary[level][position]);
+        }
+
+        return position;
+    }
+
+    void Bitmap::rebuildSummary() {
+        std::size_t wordCount = getWordCount();
+        m_summary.clear();
+        m_superwordFreeCounts.assign((wordCount + WORDS_IN_SUPERWORD - 1) / WORDS_IN_SUPERWORD, 0);
+        m_freeCount = 0;
+
+        std::size_t levelLength = wordCount;
+        do {
+            m_summary.emplace_back((levelLength + INDEXES_IN_WORD - 1) / INDEXES_IN_WORD, 0);
+            levelLength = m_summary.back().size();
+        } while (levelLength > 1);
+
+        for (std::size_t word = 0; word < wordCount; ++word) {
+            uint64_t freeBits = getFreeBits(word);
+            std::size_t freeCount = __builtin_popcountll(freeBits);
+            m_freeCount += freeCount;
+            m_superwordFreeCounts[word / WORDS_IN_SUPERWORD] += freeCount;
+            if (freeBits) {
+                m_summary[0][word / INDEXES_IN_WORD] |= 1ULL << (word % INDEXES_IN_WORD);
+            }
+        }
+
+        for (std::size_t level = 1; level < m_summary.size(); ++level) {
+            for (std::size_t i = 0; i < m_summary[level - 1].size(); ++i) {
+                if (m_summary[level - 1][i]) {
+                    m_summary[level][i / INDEXES_IN_WORD] |= 1ULL << (i % INDEXES_IN_WORD);
+                }
+            }
+        }
+    }
+
+    void Bitmap::updateSummary(std::size_t word, const bool hasFree) {
+        for (auto &level : m_summary) {
+            uint64_t& summaryWord = level[word / INDEXES_IN_WORD];
+            uint64_t mask = 1ULL << (word % INDEXES_IN_WORD);
+            bool hadFree = summaryWord != 0;
+            if (hasFree) {
+                summaryWord |= mask;
+            } else {
+                summaryWord &= ~mask;
+            }
+
+            /// Level above changes only if this summary word got it's first free word or lost the last one
+            if (hadFree == (summaryWord != 0)) {
+                return;
+            }
+            word /= INDEXES_IN_WORD;
+        }
+    }
+
+    void Bitmap::markDirty(const std::size_t byte) {
+        /// Range starting at or in front of the byte may already contain it or end right in front of it
+        auto next = m_dirtyRanges.upper_bound(byte);
+        if (next != m_dirtyRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->second > byte) {
+                return;
+            }
+            if (previous->second == byte) {
+                previous->second = byte + 1;
+                if (next != m_dirtyRanges.end() && next->first == previous->second) {
+                    previous->second = next->second;
+                    m_dirtyRanges.erase(next);
+                }
+                return;
+            }
+        }
+
+        if (next != m_dirtyRanges.end() && next->first == byte + 1) {
+            std::size_t end = next->second;
+            m_dirtyRanges.erase(next);
+            m_dirtyRanges[byte] = end;
+        } else {
+            m_dirtyRanges[byte] = byte + 1;
+        }
+    }
+
     DataLinks::DataLinks(const std::vector<int32_t> &dataClusterIndexes) {
         init();
-        for (int i = 0; i < m_directLinks.size(); ++i) {
+        for (std::size_t i = 0; i < m_directLinks.size(); ++i) {
             if (i >= dataClusterIndexes.size()) {
                 return;
             }
@@ -354,13 +1010,27 @@ namespace fs {
             m_directLinks[i] = dataClusterIndexes[i];
         }
 
-        for (int i = 0; i < m_indirectLinks.size(); ++i) {
-            size_t clusterIndex = (i * fs::Inode::LINKS_IN_INDIRECT) + i + m_directLinks.size();
-            if (clusterIndex >= dataClusterIndexes.size()) {
+        std::array<int32_t*, TREE_DEPTHS.size()> treeLinks = {
+                &m_indirectLinks[0], &m_indirectLinks[1], &m_doubleIndirectLink, &m_tripleIndirectLink
+        };
+        size_t position = m_directLinks.size();
+        for (std::size_t i = 0; i < treeLinks.size(); ++i) {
+            if (position >= dataClusterIndexes.size()) {
                 return;
             }
 
-            m_indirectLinks[i] = dataClusterIndexes[clusterIndex];
+            *treeLinks[i] = dataClusterIndexes[position];
+            walkLinkTree(TREE_DEPTHS[i], position, dataClusterIndexes.size(), nullptr);
         }
     }
+
+    std::vector<bool> DataLinks::getIndirectBlockMask(const size_t blockCount) {
+        std::vector<bool> indirect(blockCount, false);
+        size_t position = fs::Inode::DIRECT_LINKS_COUNT;
+        for (size_t depth : TREE_DEPTHS) {
+            walkLinkTree(depth, position, blockCount, &indirect);
+        }
+
+        return indirect;
+    }
 }
\ No newline at end of file
@@ -8,12 +8,17 @@
 #include <cstdint>
 #include <cstring>
 #include <array>
+#include <bitset>
+#include <map>
 #include <string>
 #include <vector>
-#include <fstream>
 #include <iostream>
 #include "../utils/ObjectNotFound.h"
 
+namespace pfs {
+    class BlockDevice;
+}
+
 /**
 * Namespace with fundamental parts of the file system.
 */
@@ -28,14 +33,38 @@ namespace fs {
      */
     constexpr int32_t EMPTY_LINK = -1;
 
+    /**
+     * Stores given value into four bytes in little-endian order, which is the byte order of every stored structure.
+     */
+    void encodeInt32(u_char* bytes, int32_t value);
+    /**
+     * Loads value stored in four bytes in little-endian order.
+     */
+    int32_t decodeInt32(const u_char* bytes);
+    /**
+     * Stores given value into eight bytes in little-endian order.
+     */
+    void encodeInt64(u_char* bytes, int64_t value);
+    /**
+     * Loads value stored in eight bytes in little-endian order.
+     */
+    int64_t decodeInt64(const u_char* bytes);
+
     /**
      * Super-block is the most important structure in the file system. It contains all the much needed information
      * such as size of the disk, number of I-Nodes, addresses of bitmaps and data blocks etc. It is always stored
      * at the front of file system.
+     *
+     * Sizes, counts and addresses are stored as 64-bit numbers behind the version of the on-disk format.
+     * Clusters and i-nodes are still addressed by 32-bit links and IDs, so their counts are limited to fit them.
      */
     class Superblock {
     public: //public attributes
         static constexpr size_t CLUSTER_SIZE = 4096;            //default cluster size in bytes
+        static constexpr size_t CLUSTERS_PER_GROUP = 2048;      //number of clusters in one allocation group
+        static constexpr int32_t FORMAT_VERSION = 5;            //version of the on-disk format, 4 without file types in directory items and with 12 characters long names
+        static constexpr size_t MIN_DISK_SIZE_MB = 2;           //minimal size of the disk in megabytes
+        static constexpr size_t MAX_DISK_SIZE_MB = 2000000;     //maximal size of the disk in megabytes, keeps i-node IDs in 32 bits
     private: //private attributes
         static constexpr size_t SIGNATURE_LENGTH = 10;          //length of author's signature
         static constexpr size_t VOLUME_DESC_LENGTH = 20;        //volume description length
@@ -44,19 +73,29 @@ namespace fs {
 
         std::array<char, SIGNATURE_LENGTH> m_signature;               //FS author login
         std::array<char, VOLUME_DESC_LENGTH> m_volumeDescription;     //FS description
-        int32_t m_diskSize;                   //FS size
-        int32_t m_inodeCount;                 //maximum number of i-nodes in file system
-        int32_t m_clusterCount;               //number of clusters in FS
-        int32_t m_inodeBitmapStartAddress;    //start address of inode bitmap
-        int32_t m_dataBitmapStartAddress;     //start address of data bitmap
-        int32_t m_inodeStartAddress;          //start address of i-nodes
-        int32_t m_dataStartAddress;           //start address of data blocks
+        int32_t m_formatVersion = 0;              //version of the on-disk format
+        int64_t m_diskSize = 0;                   //FS size
+        int64_t m_inodeCount = 0;                 //maximum number of i-nodes in file system
+        int64_t m_clusterCount = 0;               //number of clusters in FS
+        int64_t m_inodeBitmapStartAddress = 0;    //start address of inode bitmap
+        int64_t m_dataBitmapStartAddress = 0;     //start address of data bitmap
+        int64_t m_inodeStartAddress = 0;          //start address of i-nodes
+        int64_t m_dataStartAddress = 0;           //start address of data blocks
+        int64_t m_initializedClusterCount = 0;    //number of clusters written since format, the rest is still zero
+
+    public: //public attributes
+        /// Offset of the initialized cluster count in the stored super-block
+        static constexpr size_t INITIALIZED_CLUSTER_COUNT_OFFSET = SIGNATURE_LENGTH + VOLUME_DESC_LENGTH + sizeof(int32_t)
+                + 7 * sizeof(int64_t);
+        /// Size of the stored super-block, fields are stored packed one after another
+        static constexpr size_t DISK_SIZE = SIGNATURE_LENGTH + VOLUME_DESC_LENGTH + sizeof(int32_t) + 8 * sizeof(int64_t);
 
     public: //public methods
         /**
-         * Initializes super-block to default values
+         * Initializes super-block to default values. If the size is out of the allowed range, the super-block
+         * is left invalid with zero disk size.
          *
-         * @param diskSize      size of file system to be represented by this super-block
+         * @param diskSize      size of file system to be represented by this super-block, in megabytes
          */
         explicit Superblock(size_t newDiskSize);
         Superblock() = default;
@@ -69,48 +108,99 @@ namespace fs {
         [[nodiscard]] const std::array<char, SIGNATURE_LENGTH> &getSignature() const;
         /** Getter for volume description. */
         [[nodiscard]] const std::array<char, VOLUME_DESC_LENGTH> &getVolumeDescription() const;
+        /** Getter for the version of the on-disk format. */
+        [[nodiscard]] int32_t getFormatVersion() const;
         /** Getter for the disk size. */
-        [[nodiscard]] int32_t getDiskSize() const;
+        [[nodiscard]] int64_t getDiskSize() const;
         /** Getter for the maximal cluster count. */
-        [[nodiscard]] int32_t getClusterCount() const;
+        [[nodiscard]] int64_t getClusterCount() const;
         /** Getter for the i-node-bitmap start address. */
-        [[nodiscard]] int32_t getInodeBitmapStartAddress() const;
+        [[nodiscard]] int64_t getInodeBitmapStartAddress() const;
         /** Getter for the data-bitmap start address.  */
-        [[nodiscard]] int32_t getDataBitmapStartAddress() const;
+        [[nodiscard]] int64_t getDataBitmapStartAddress() const;
         /** Getter for the address where i-node storage begins. */
-        [[nodiscard]] int32_t getInodeStartAddress() const;
+        [[nodiscard]] int64_t getInodeStartAddress() const;
         /** Getter for the address where data blocks storage begins. */
-        [[nodiscard]] int32_t getDataStartAddress() const;
+        [[nodiscard]] int64_t getDataStartAddress() const;
         /** Getter for the maximum i-node count. */
-        [[nodiscard]] int32_t getInodeCount() const;
+        [[nodiscard]] int64_t getInodeCount() const;
+        /** Getter for the number of clusters written since format. */
+        [[nodiscard]] int64_t getInitializedClusterCount() const;
+        /**
+         * Returns the number of allocation groups. Clusters are split into groups of CLUSTERS_PER_GROUP clusters and
+         * i-nodes into the same number of groups, each with it's own part of both bitmaps.
+         */
+        [[nodiscard]] int32_t getGroupCount() const;
+        /** Returns the number of i-nodes in one allocation group, always a multiple of 8. */
+        [[nodiscard]] int32_t getInodesPerGroup() const;
+        /**
+         * Returns the number of allocation groups of the i-node bitmap. It may be lower than @a getGroupCount, when
+         * the i-nodes per group are rounded up to whole bytes.
+         */
+        [[nodiscard]] int32_t getInodeGroupCount() const;
+        /** Returns the allocation group of the i-node with given ID. */
+        [[nodiscard]] int32_t getInodeGroup(int32_t inodeId) const;
 
-        void save(std::fstream& dataFile, size_t address) const;
-        void load(std::ifstream& dataFile, size_t address);
+        void save(pfs::BlockDevice& device, size_t address) const;
+        void load(const pfs::BlockDevice& device, size_t address);
     };
 
     class DataLinks;
 
+    /**
+     * Run of consecutive data clusters of a file.
+     */
+    struct Extent {
+        int32_t start = EMPTY_LINK;     //index of the first cluster
+        int32_t length = 0;             //number of clusters
+    };
+
     /**
      * One I-Node describes exactly one file. Directory is also file and can be described by I-Node. It also
      * describes all the data that the file is containing with direct and indirect links. Inode structure has
      * 5 direct links allowed and 2 indirect links allowed, if one stored big files and would run out of direct links.
-     * Every Inode is completely represented and can be found by it's ID.
+     * Even bigger files continue into a double indirect link, pointing to a block of indirect links, and a triple
+     * indirect link, pointing to a block of double indirect links. Every Inode is completely represented and can be
+     * found by it's ID.
+     *
+     * Regular files may be mapped by extents instead of links. The space of the links then holds up to
+     * INLINE_EXTENTS_COUNT extents and a link to the root of an extent tree, which holds all the extents
+     * of files with more of them. Directories are always mapped by links.
+     *
+     * Contents of regular files up to INLINE_DATA_SIZE bytes are stored in the i-node itself, in place of the links,
+     * so such files take no data cluster at all.
      */
     class Inode {
     public: //public attributes
         static constexpr size_t DIRECT_LINKS_COUNT = 5;     //number of allowed direct links to data blocks
         static constexpr size_t INDIRECT_LINKS_COUNT = 2;   // number of allowed indirect links to data blocks
         static constexpr size_t LINKS_IN_INDIRECT = fs::Superblock::CLUSTER_SIZE / sizeof(int32_t); //number of direct links that fit into indirect link
+        static constexpr size_t DISK_SIZE = 128;            //size of stored i-node, fields are packed and the rest is free for inline data
+        static constexpr size_t INLINE_DATA_SIZE = DISK_SIZE - 2 * sizeof(int32_t) - 2 * sizeof(int8_t) - sizeof(int64_t); //max size of file data stored in the i-node itself
+        static constexpr size_t INLINE_EXTENTS_COUNT = 4;   //number of extents stored in the i-node itself
+        static constexpr size_t EXTENTS_IN_BLOCK = fs::Superblock::CLUSTER_SIZE / sizeof(Extent) - 1; //number of entries in a block of extent tree, behind it's header
     private: //private attributes
+        static constexpr u_char DIRECTORY_FLAG = 0x01;      //stored flag of directories
+        static constexpr u_char EXTENTS_FLAG = 0x02;        //stored flag of i-nodes mapped by extents
+        static constexpr u_char INLINE_DATA_FLAG = 0x04;    //stored flag of i-nodes holding the file data themselves
+
         int32_t m_inodeId = fs::FREE_INODE_ID;                     //i-node id - if nodeId = FREE_INODE_ID, then the inode is free
         bool m_isDirectory = false;                   //file or directory
+        bool m_usesExtents = false;                   //is the file mapped by extents instead of links?
         int8_t m_references = 1;                  //number of references on i-node - used for hardlinks
-        int32_t m_fileSize = 0;                   //size of file in bytes
+        int64_t m_fileSize = 0;                   //size of file in bytes
+        int32_t m_parentId = fs::FREE_INODE_ID;   //i-node id of the directory containing the file, root is it's own parent
         std::array<int32_t, DIRECT_LINKS_COUNT> m_directLinks{}; // direct links to data blocks
         std::array<int32_t, INDIRECT_LINKS_COUNT> m_indirectLinks{};   // indirect links to data blocks
+        int32_t m_doubleIndirectLink = EMPTY_LINK;    // link to a block of indirect links
+        int32_t m_tripleIndirectLink = EMPTY_LINK;    // link to a block of double indirect links
+        std::array<Extent, INLINE_EXTENTS_COUNT> m_extents{};   // extents stored in the i-node
+        int32_t m_extentTreeLink = EMPTY_LINK;    // link to the root block of extent tree
+        bool m_hasInlineData = false;             //is the file data stored in the i-node?
+        std::array<char, INLINE_DATA_SIZE> m_inlineData{};  // file data stored in the i-node
     public: //public methods
         Inode();
-        Inode(int32_t nodeId, bool isDirectory, int32_t fileSize);
+        Inode(int32_t nodeId, bool isDirectory, int64_t fileSize);
         /// Returns inode's ID
         [[nodiscard]] int32_t getInodeId() const;
         /// Sets inode's ID to new value
@@ -124,13 +214,57 @@ namespace fs {
         /// Sets number of references to this inode to new value
         void setReferences(int8_t references);
         /// Returns the size of a file represented by this inode
-        [[nodiscard]] int32_t getFileSize() const;
+        [[nodiscard]] int64_t getFileSize() const;
         /// Sets the size of a file, represented by this inode, to new value
-        void setFileSize(int32_t fileSize);
+        void setFileSize(int64_t fileSize);
+        /// Returns the i-node ID of the directory containing this file
+        [[nodiscard]] int32_t getParentId() const;
+        /// Sets the i-node ID of the directory containing this file
+        void setParentId(int32_t parentId);
         /// Returns the array of direct data links
         [[nodiscard]] const std::array<int32_t, DIRECT_LINKS_COUNT> &getDirectLinks() const;
         /// Returns the array if indirect data links
         [[nodiscard]] const std::array<int32_t, INDIRECT_LINKS_COUNT> &getIndirectLinks() const;
+        /// Returns the double indirect data link
+        [[nodiscard]] int32_t getDoubleIndirectLink() const;
+        /// Returns the triple indirect data link
+        [[nodiscard]] int32_t getTripleIndirectLink() const;
+        /// Returns the link to given tree following the direct links, trees are ordered as @a fs::DataLinks::TREE_DEPTHS
+        [[nodiscard]] int32_t getTreeLink(size_t tree) const;
+        /// Sets the link to given tree following the direct links
+        void setTreeLink(size_t tree, int32_t link);
+        /// Sets the direct link with given index
+        void setDirectLink(size_t index, int32_t link);
+        /// Checks if the file is mapped by extents instead of links
+        [[nodiscard]] bool usesExtents() const;
+        /// Returns the extents stored in the i-node, unused ones have zero length
+        [[nodiscard]] const std::array<Extent, INLINE_EXTENTS_COUNT> &getInlineExtents() const;
+        /// Returns the link to the root block of extent tree, EMPTY_LINK if the extents are stored in the i-node
+        [[nodiscard]] int32_t getExtentTreeLink() const;
+        /**
+         * Maps the file by given extents stored in the i-node. All links are cleared.
+         *
+         * @param extents extents of the file, at most INLINE_EXTENTS_COUNT
+         * @throw invalid_argument if there is more extents than fit into the i-node
+         */
+        void setExtents(const std::vector<Extent>& extents);
+        /**
+         * Maps the file by the extent tree with given root block. All links are cleared.
+         *
+         * @param rootLink link to the root block of extent tree
+         */
+        void setExtentTree(int32_t rootLink);
+        /// Checks if the file data is stored in the i-node itself
+        [[nodiscard]] bool hasInlineData() const;
+        /// Returns the file data stored in the i-node, file size bytes long
+        [[nodiscard]] std::string getInlineData() const;
+        /**
+         * Stores given file data in the i-node itself. All links and extents are cleared.
+         *
+         * @param data file data, at most INLINE_DATA_SIZE bytes long
+         * @throw invalid_argument if the data doesn't fit into the i-node
+         */
+        void setInlineData(const std::string& data);
         /**
          * Returns the value of last filled direct data link.
          * @return value of last filled data link
@@ -151,10 +285,14 @@ namespace fs {
          * @return index of first free indirect data link
          */
         [[nodiscard]] int32_t getFirstFreeIndirectLink() const;
-        /// Saves inode data into given data file at given address
-        void save(std::fstream& dataFile, size_t address) const;
-        /// Loads inode data from given data file from given address
-        void load(std::ifstream& dataFile, size_t address);
+        /// Saves inode data into given device at given address
+        void save(pfs::BlockDevice& device, size_t address) const;
+        /// Loads inode data from given device from given address
+        void load(const pfs::BlockDevice& device, size_t address);
+        /// Stores inode data into given record of DISK_SIZE bytes, the way they are saved
+        void encode(u_char* record) const;
+        /// Loads inode data from given record of DISK_SIZE bytes
+        void decode(const u_char* record);
         /// Adds given direct link to this inode
         bool addDirectLink(int32_t index);
         /**
@@ -174,11 +312,11 @@ namespace fs {
          */
         void clearIndirectLink(int32_t address);
         /**
-         * Clears all direct and indirect links, setting them to @a fs::EMPTY_LINK
+         * Clears all direct and indirect links, setting them to @a fs::EMPTY_LINK, and all extents
          */
         void clearData();
         /**
-         * Fills this inode's direct and indirect links with given data links.
+         * Fills this inode's direct and indirect links with given data links, so the file is mapped by links.
          *
          * @param dataLinks data links to fill inode with
          */
@@ -187,6 +325,12 @@ namespace fs {
         void init() {
             m_directLinks.fill(EMPTY_LINK);
             m_indirectLinks.fill(EMPTY_LINK);
+            m_doubleIndirectLink = EMPTY_LINK;
+            m_tripleIndirectLink = EMPTY_LINK;
+            m_extents.fill(Extent());
+            m_extentTreeLink = EMPTY_LINK;
+            m_hasInlineData = false;
+            m_inlineData.fill(0);
         }
     };
 
@@ -220,16 +364,42 @@ namespace fs {
     V getFirstFreeIndex(const T& conteiner, V emptyValue);
 
     /**
-     * Represents one item in directory. Only carries information about name of the item
-     * and id of corresponding i-node. All the other information, like if it is directory, data links, etc. is
-     * carried by the inode structure with provided id.
+     * Types of files, stored in directory items so the directory can be listed without reading the i-nodes.
+     */
+    enum class FileType : u_char {
+        /**
+         * Type is not known, the item is free.
+         */
+        UNKNOWN = 0,
+        /**
+         * Regular file.
+         */
+        REGULAR = 1,
+        /**
+         * Directory.
+         */
+        DIRECTORY = 2
+    };
+
+    /**
+     * Represents one item in directory. Only carries information about name of the item, id of corresponding i-node
+     * and the type of the file. All the other information, like data links, size, etc. is carried by the inode
+     * structure with provided id.
+     *
+     * Item is stored as the i-node ID, the name padded by zeros and one byte of the file type. The type byte used to
+     * be the terminating zero of the name before format version 5, so names are stored by at most MAX_NAME_LENGTH
+     * characters. Directories of older versions could hold 12 characters long names, whose last character would be
+     * read as the type, that's why the data files of older versions are refused at mount and have to be formatted again.
      */
     class DirectoryItem {
     public: //public attributes
         static constexpr size_t DIR_ITEM_NAME_LENGTH = 12; //length of directory item name (8 chars + 3 chars for extension + \0)
+        static constexpr size_t MAX_NAME_LENGTH = DIR_ITEM_NAME_LENGTH - 1; //number of stored characters of the name, the last byte holds the file type
+        static constexpr size_t DISK_SIZE = sizeof(int32_t) + DIR_ITEM_NAME_LENGTH; //size of stored directory item
     private: //private attributes
         int32_t m_inodeId = FREE_INODE_ID;                    //id of corresponding i-node
         std::array<char, DIR_ITEM_NAME_LENGTH> m_itemName{};   //name of directory item
+        FileType m_fileType = FileType::UNKNOWN;              //type of the file of corresponding i-node
     public: //public methods
         /**
          * Default constructor for initialization of directory item into non-viable state.
@@ -239,10 +409,11 @@ namespace fs {
         /**
          * Default constructor for initialization of directory item.
          *
-         * @param itemName name of the file/folder
+         * @param itemName name of the file/folder, only MAX_NAME_LENGTH characters are kept
          * @param inodeId id of corresponding inode
+         * @param fileType type of the file/folder
          */
-        explicit DirectoryItem(const std::string& itemName, int32_t inodeId);
+        DirectoryItem(const std::string& itemName, int32_t inodeId, FileType fileType);
         DirectoryItem(const DirectoryItem& other) = default;
         DirectoryItem(DirectoryItem&& other) = default;
         DirectoryItem& operator=(const DirectoryItem& other) = default;
@@ -265,16 +436,123 @@ namespace fs {
         [[nodiscard]] int32_t getInodeId() const;
         /** Getter for item name. */
         [[nodiscard]] const std::array<char, DIR_ITEM_NAME_LENGTH> &getItemName() const;
-        /// Saves directory item data to given data file at given address
-        void save(std::fstream& dataFile, size_t address) const;
-        /// Loads directory item data from given data file from given address
-        void load(std::ifstream& dataFile, size_t address);
+        /// Returns the type of the file of this item
+        [[nodiscard]] FileType getFileType() const;
+        /// Checks if this item is a directory
+        [[nodiscard]] bool isDirectory() const;
+        /// Checks if this item is an empty slot, having no name
+        [[nodiscard]] bool isFree() const;
+        /// Returns the hash of this item's name, @a hashName of the name
+        [[nodiscard]] uint32_t getNameHash() const;
+        /// Saves directory item data to given device at given address
+        void save(pfs::BlockDevice& device, size_t address) const;
+        /// Loads directory item data from given device from given address
+        void load(const pfs::BlockDevice& device, size_t address);
+        /// Stores directory item data into given record of DISK_SIZE bytes, the way they are saved
+        void encode(u_char* record) const;
+        /// Loads directory item data from given record of DISK_SIZE bytes
+        void decode(const u_char* record);
+    };
+
+    /**
+     * Returns the hash of given name of a directory item, by which it is found in the directory index.
+     * Only the part of the name fitting into a directory item is hashed.
+     */
+    uint32_t hashName(const std::string& name);
+
+    /**
+     * Header of a directory index, stored in the first cluster of every directory behind the items "." and "..".
+     *
+     * Directory items are stored in buckets, in spirit of ext4 htree. Index is an extendible hash table - low
+     * @a globalDepth bits of the name hash select an entry of the bucket table, holding the cluster of the bucket.
+     * Buckets with local depth lower than the global one are selected by several entries. The bucket table is stored
+     * in clusters linked from the header, buckets are linked by the directory i-node as the rest of the directory
+     * data, so they are listed in the order of creation.
+     */
+    class DirectoryHeader {
+    public: //public attributes
+        static constexpr size_t OFFSET = 2 * DirectoryItem::DISK_SIZE;      //offset of the header in the first cluster
+        static constexpr size_t ENTRIES_IN_TABLE_CLUSTER = Superblock::CLUSTER_SIZE / sizeof(int32_t); //bucket table entries in one cluster
+        static constexpr size_t MAX_TABLE_CLUSTERS = (Superblock::CLUSTER_SIZE - OFFSET) / sizeof(int32_t) - 3; //number of table links behind the header fields
+        static constexpr int32_t MAX_DEPTH = 19;                            //maximal global depth, the table fits into MAX_TABLE_CLUSTERS
+    private: //private attributes
+        int32_t m_globalDepth = 0;              //number of hash bits selecting the bucket table entry
+        int32_t m_bucketCount = 0;              //number of buckets, zero if no item was stored yet
+        int32_t m_itemCount = 0;                //number of items in the buckets, without "." and ".."
+        std::vector<int32_t> m_tableLinks;      //clusters holding the bucket table
+    public: //public methods
+        /** Getter for the global depth. */
+        [[nodiscard]] int32_t getGlobalDepth() const;
+        /** Getter for the number of buckets. */
+        [[nodiscard]] int32_t getBucketCount() const;
+        /** Getter for the number of items in the buckets. */
+        [[nodiscard]] int32_t getItemCount() const;
+        /** Getter for the clusters holding the bucket table. */
+        [[nodiscard]] const std::vector<int32_t>& getTableLinks() const;
+        /** Returns the number of entries of the bucket table. */
+        [[nodiscard]] size_t getTableSize() const;
+        /** Returns the bucket table entry selected by given name hash. */
+        [[nodiscard]] size_t getTableEntry(uint32_t hash) const;
+        void setGlobalDepth(int32_t globalDepth);
+        void setBucketCount(int32_t bucketCount);
+        void setItemCount(int32_t itemCount);
+        void setTableLinks(const std::vector<int32_t>& tableLinks);
+        /// Stores the header into given first cluster of a directory
+        void encode(u_char* cluster) const;
+        /// Loads the header from given first cluster of a directory
+        void decode(const u_char* cluster);
     };
 
     /**
-     * Wrapper class for dynamic initialization of inode and data-block bitmaps.
+     * Bucket of a directory index, one cluster of directory items. The first slot holds the local depth - number
+     * of low hash bits shared by all the items of the bucket.
+     */
+    class DirectoryBucket {
+    public: //public attributes
+        static constexpr size_t ITEM_COUNT = Superblock::CLUSTER_SIZE / DirectoryItem::DISK_SIZE - 1; //number of items in one bucket
+    private: //private attributes
+        int32_t m_localDepth = 0;                           //number of hash bits shared by all items
+        std::array<DirectoryItem, ITEM_COUNT> m_items{};    //items of the bucket, free slots have no name
+    public: //public methods
+        /** Getter for the local depth. */
+        [[nodiscard]] int32_t getLocalDepth() const;
+        void setLocalDepth(int32_t localDepth);
+        /** Getter for the items, free slots included. */
+        [[nodiscard]] const std::array<DirectoryItem, ITEM_COUNT>& getItems() const;
+        /// Returns the slot of the item with given name, ITEM_COUNT if there is none
+        [[nodiscard]] size_t findItem(const std::string& name) const;
+        /// Returns the bitmap of slots holding an item
+        [[nodiscard]] std::bitset<ITEM_COUNT> getUsedSlots() const;
+        /// Stores given item into given slot
+        void setItem(size_t slot, const DirectoryItem& item);
+        /// Returns the offset of given slot in the cluster of the bucket
+        [[nodiscard]] static size_t getSlotOffset(size_t slot);
+        /// Stores the bucket into given cluster
+        void encode(u_char* cluster) const;
+        /// Loads the bucket from given cluster
+        void decode(const u_char* cluster);
+    };
+
+    /**
+     * Wrapper class for dynamic initialization of inode and data-block bitmaps. Index @a i is stored in the byte
+     * @a i / 8 as the bit @a 7 - (i % 8), so the first index of every byte is it's most significant bit.
+     *
+     * Bitmap is scanned 64 bits (one word) at a time. On top of the words it keeps a summary, so that free indexes
+     * are found in logarithmic time no matter how full the bitmap is. First summary level has one bit per word,
+     * set if the word has any free index, every next level has one bit per word of the level below. Free indexes
+     * are also counted per superword of @a WORDS_IN_SUPERWORD words.
+     *
+     * Bitmap remembers which byte ranges were changed since it was last saved or loaded and saves only those.
      */
     class Bitmap {
+    public:
+        /// Number of indexes stored in one word
+        static constexpr std::size_t INDEXES_IN_WORD = 64;
+        /// Number of words counted together in one superword
+        static constexpr std::size_t WORDS_IN_SUPERWORD = 64;
+        /// Dirty ranges closer to each other than this number of bytes are saved as one range
+        static constexpr std::size_t DIRTY_RANGE_GAP = 64;
+    private:
         /**
          * The bitmap itself.
          */
@@ -283,12 +561,37 @@ namespace fs {
          * Length of the bitmap.
          */
         std::size_t m_length;
+        /**
+         * Number of free indexes in the bitmap.
+         */
+        std::size_t m_freeCount;
+        /**
+         * Summary levels, bit @a j of the level @a k is set if the word @a j of the level below has any free index.
+         * Level below the first one are the words of the bitmap itself.
+         */
+        std::vector<std::vector<uint64_t>> m_summary;
+        /**
+         * Number of free indexes in every superword.
+         */
+        std::vector<uint32_t> m_superwordFreeCounts;
+        /**
+         * Byte ranges changed since the bitmap was last saved or loaded, start of the range mapped to it's end.
+         * Ranges never overlap nor touch.
+         */
+        std::map<std::size_t, std::size_t> m_dirtyRanges;
     public:
+        /**
+         * Creates bitmap of given length with every index free. Whole new bitmap is dirty.
+         *
+         * @param length length of the bitmap in bytes
+         */
         explicit Bitmap(const std::size_t length = 0)
-                    : m_length(length), m_bitmap(length ? new u_char[length] : nullptr){
+                    : m_bitmap(length ? new u_char[length] : nullptr), m_length(length), m_freeCount(length * 8) {
             if (length) {
                 memset(m_bitmap, 0, length);
+                m_dirtyRanges[0] = length;
             }
+            rebuildSummary();
         }
         /**
          * Friend swap function, required for operator= and move constructor implementation.
@@ -302,6 +605,10 @@ namespace fs {
 
             swap(firstBitmap.m_length, secondBitmap.m_length);
             swap(firstBitmap.m_bitmap, secondBitmap.m_bitmap);
+            swap(firstBitmap.m_freeCount, secondBitmap.m_freeCount);
+            swap(firstBitmap.m_summary, secondBitmap.m_summary);
+            swap(firstBitmap.m_superwordFreeCounts, secondBitmap.m_superwordFreeCounts);
+            swap(firstBitmap.m_dirtyRanges, secondBitmap.m_dirtyRanges);
         }
 
         /**
@@ -310,7 +617,9 @@ namespace fs {
          * @param otherBitmap copied instance
          */
         Bitmap(const fs::Bitmap &otherBitmap)
-                    : m_length(otherBitmap.m_length), m_bitmap(otherBitmap.m_length ? new u_char[otherBitmap.m_length] : nullptr){
+                    : m_bitmap(otherBitmap.m_length ? new u_char[otherBitmap.m_length] : nullptr), m_length(otherBitmap.m_length),
+                    m_freeCount(otherBitmap.m_freeCount), m_summary(otherBitmap.m_summary),
+                    m_superwordFreeCounts(otherBitmap.m_superwordFreeCounts), m_dirtyRanges(otherBitmap.m_dirtyRanges) {
             std::copy(otherBitmap.m_bitmap, otherBitmap.m_bitmap + otherBitmap.m_length, m_bitmap);
         }
 
@@ -347,25 +656,26 @@ namespace fs {
         [[nodiscard]] size_t getLength() const {
             return m_length;
         }
-        /// Saves bitmap data into given data file to given address
-        void save(std::fstream& dataFile, const size_t address) const {
-            if (!dataFile.is_open()) {
-                throw std::invalid_argument("Předaný datový soubor není otevřen pro zápis");
-            }
-
-            dataFile.seekp(address, std::ios_base::beg);
-            dataFile.write((char*)m_bitmap, m_length);
-            dataFile.flush();
+        /// Returns the number of free indexes in this bitmap
+        [[nodiscard]] size_t getFreeCount() const {
+            return m_freeCount;
         }
-        /// Loads bitmap data from given data file from given address
-        void load(std::ifstream& dataFile, const size_t address) {
-            if (!dataFile.is_open()) {
-                throw std::invalid_argument("Předaný datový soubor není otevřen ke čtení");
-            }
-
-            dataFile.seekg(address, std::ios_base::beg);
-            dataFile.read((char*)m_bitmap, m_length);
+        /**
+         * Returns the number of free indexes in given superword, covering indexes from
+         * @a superword * WORDS_IN_SUPERWORD * INDEXES_IN_WORD.
+         *
+         * @param superword index of the superword
+         * @return number of free indexes in the superword, zero if the superword is out of the bitmap
+         */
+        [[nodiscard]] size_t getSuperwordFreeCount(std::size_t superword) const;
+        /// Checks if the bitmap was changed since it was last saved or loaded
+        [[nodiscard]] bool isDirty() const {
+            return !m_dirtyRanges.empty();
         }
+        /// Saves changed byte ranges of the bitmap into given device to given address, as one batch
+        void save(pfs::BlockDevice& device, size_t address);
+        /// Loads bitmap data from given device from given address and rebuilds it's summary
+        void load(const pfs::BlockDevice& device, size_t address);
         /**
          * Returns given number of free indexes. Throws ObjectNotFound if none or less than given number of indexes is found.
          *
@@ -373,23 +683,15 @@ namespace fs {
          * @return vector if free indexes
          * @throw ObjectNotFound if none or less than `count` free indexes is found
          */
-        [[nodiscard]] std::vector<int32_t> findFreeIndexes(const std::size_t count) const {
-            std::vector<int32_t> freeIndexes;
-            /// Iterating through the data bitmap
-            for (int i = 0; i < m_length; ++i) {
-                for (int j = 7; j >= 0; --j) {
-                    if (!((m_bitmap[i] >> j) & 0b1)) {
-                        freeIndexes.push_back((i * 8) + (7 - j));
-                        if (freeIndexes.size() == count) {
-                            return freeIndexes;
-                        }
-                    }
-                }
-            }
+        [[nodiscard]] std::vector<int32_t> findFreeIndexes(std::size_t count) const;
 
-            /// No free index found or not enough of free indexes
-            throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných indexů bitmapy");
-        }
+        /**
+         * Returns all runs of consecutive free indexes below given index count, ordered by their first index.
+         *
+         * @param indexCount number of valid indexes, indexes behind are ignored
+         * @return pairs of the first index of a run and the length of the run
+         */
+        [[nodiscard]] std::vector<std::pair<std::size_t, std::size_t>> findFreeRuns(std::size_t indexCount) const;
 
         /**
          * Finds first free index in this bitmap. If none is found, throws ObjectNotFound.
@@ -397,47 +699,19 @@ namespace fs {
          * @return first free index
          * @throw ObjectNotFound if no free index is found
          */
-        [[nodiscard]] int32_t findFirstFreeIndex() const {
-            /// We go through the entire bitmap
-            for (std::size_t i = 0; i < m_length; ++i) {
-                for (int j = 7; j >= 0; --j) {
-                    if (!((m_bitmap[i] >> j) & 0b1)) {
-                        /// If the bit is 0, we return it's index as the inode id
-                        return (i * 8) + (7 - j);
-                    }
-                }
-            }
-            /// If we get here, the bitmap is full
-            throw pfs::ObjectNotFound("Nenalezen žádný volný index v bitmapě");
-        }
+        [[nodiscard]] int32_t findFirstFreeIndex() const;
 
         /**
          * Sets index-th bit in this bitmap to 1
          * @param index index to set to 1
          */
-        void setIndexFilled(const std::size_t index) {
-            std::size_t bitmapIndex = index / 8;
-            if (bitmapIndex >= m_length) {
-                return;
-            }
-
-            std::size_t subIndex = 7 - (index % 8);
-            m_bitmap[bitmapIndex] |= 1UL << subIndex;
-        }
+        void setIndexFilled(std::size_t index);
 
         /**
          * Sets index-th bit in this bitmap to 0
          * @param index index to set to 0
          */
-        void setIndexFree(const std::size_t index) {
-            std::size_t bitmapIndex = index / 8;
-            if (bitmapIndex >= m_length) {
-                return;
-            }
-
-            std::size_t subIndex =  7 - (index % 8);
-            m_bitmap[bitmapIndex] &= ~(1UL << subIndex);
-        }
+        void setIndexFree(std::size_t index);
 
         /**
          * Checks if index-th bit is set to 1
@@ -454,27 +728,58 @@ namespace fs {
             std::size_t subIndex = 7 - (index % 8);
             return (m_bitmap[bitmapIndex] >> subIndex) & 0b1;
         }
+
+    private:
+        /// Returns number of words of this bitmap, the last one may be only partially stored
+        [[nodiscard]] std::size_t getWordCount() const;
+        /// Returns free bits of given word, the first index of the word is the most significant bit
+        [[nodiscard]] uint64_t getFreeBits(std::size_t word) const;
+        /// Returns the first word at or behind given one with any free index, or the word count if there is none
+        [[nodiscard]] std::size_t findFreeWord(std::size_t word) const;
+        /// Counts the free indexes and builds the summary levels from the stored bitmap
+        void rebuildSummary();
+        /// Sets or clears the summary bit of given word on every level it changes
+        void updateSummary(std::size_t word, bool hasFree);
+        /// Marks given byte of the bitmap as changed
+        void markDirty(std::size_t byte);
     };
 
     /**
      * Class uniting direct and indirect links to data blocks of a file.
      */
     class DataLinks {
+    public://public attributes
+        /**
+         * Depths of the link trees following the direct links of an inode - two indirect links, double indirect link
+         * and triple indirect link. Link of depth 0 points to a data block.
+         */
+        static constexpr std::array<size_t, fs::Inode::INDIRECT_LINKS_COUNT + 2> TREE_DEPTHS = { 1, 1, 2, 3 };
     private://private attributes
         std::array<int32_t, fs::Inode::DIRECT_LINKS_COUNT> m_directLinks{};
         std::array<int32_t, fs::Inode::INDIRECT_LINKS_COUNT> m_indirectLinks{};
+        int32_t m_doubleIndirectLink = EMPTY_LINK;
+        int32_t m_tripleIndirectLink = EMPTY_LINK;
 
     public://public methods
         /**
          * Creates an instance of data links from given vector of data block indexes.
          * First @a fs::Inode::DIRECT_LINKS_COUNT indexes will be treated as direct links.
          * Then, repeatedly, following index will be treated as indirect link and next
-         * @a fs::Inode::DIRECT_LINKS_COUNT indexes will be skipped - should be stored in previous
+         * @a fs::Inode::LINKS_IN_INDIRECT indexes will be skipped - should be stored in previous
          * indirect link. Following index is again treated as another indirect link and so on.
+         * Double and triple indirect links follow the same way, every block of links being followed
+         * by the blocks it links to.
          *
          * @param dataClusterIndexes
          */
         explicit DataLinks(const std::vector<int32_t>& dataClusterIndexes);
+        /**
+         * Returns which of the data blocks of a file, ordered the way they are linked, hold links instead of data.
+         *
+         * @param blockCount number of data blocks of the file, including the ones holding links
+         * @return true for every data block holding links
+         */
+        [[nodiscard]] static std::vector<bool> getIndirectBlockMask(size_t blockCount);
 
         [[nodiscard]] std::array<int32_t, fs::Inode::DIRECT_LINKS_COUNT> getDirectLinks() const noexcept {
             return m_directLinks;
@@ -484,10 +789,20 @@ namespace fs {
             return m_indirectLinks;
         }
 
+        [[nodiscard]] int32_t getDoubleIndirectLink() const noexcept {
+            return m_doubleIndirectLink;
+        }
+
+        [[nodiscard]] int32_t getTripleIndirectLink() const noexcept {
+            return m_tripleIndirectLink;
+        }
+
     private://private methods
         void init() {
             m_directLinks.fill(fs::EMPTY_LINK);
             m_indirectLinks.fill(fs::EMPTY_LINK);
+            m_doubleIndirectLink = fs::EMPTY_LINK;
+            m_tripleIndirectLink = fs::EMPTY_LINK;
         }
     };
 
@@ -0,0 +1,66 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <algorithm>
+#include <array>
+#include "BlockDevice.h"
+#include "FileBlockDevice.h"
+#include "MappedBlockDevice.h"
+#include "UringBlockDevice.h"
+#include "../common/structures.h"
+
+std::shared_ptr<pfs::BlockDevice> pfs::BlockDevice::open(const std::string &fileName, const IoBackend backend,
+                                                         const bool truncate, const std::size_t size) {
+    switch (backend) {
+        case IoBackend::MMAP:
+            return std::make_shared<pfs::MappedBlockDevice>(fileName, truncate, size);
+        case IoBackend::URING:
+            return std::make_shared<pfs::UringBlockDevice>(fileName, truncate, size);
+        case IoBackend::PREAD:
+        default:
+            return std::make_shared<pfs::FileBlockDevice>(fileName, truncate, size);
+    }
+}
+
+void pfs::BlockDevice::setDataStartAddress(const std::size_t dataStartAddress) {
+    m_dataStartAddress = dataStartAddress;
+}
+
+std::size_t pfs::BlockDevice::getDataStartAddress() const {
+    return m_dataStartAddress;
+}
+
+std::size_t pfs::BlockDevice::clusterAddress(const int32_t cluster) const {
+    return m_dataStartAddress + (cluster * fs::Superblock::CLUSTER_SIZE);
+}
+
+void pfs::BlockDevice::zero(std::size_t address, std::size_t length) {
+    static const std::array<char, fs::Superblock::CLUSTER_SIZE> zeros { 0 };
+    while (length > 0) {
+        std::size_t chunk = std::min(length, zeros.size());
+        write(address, zeros.data(), chunk);
+        address += chunk;
+        length -= chunk;
+    }
+}
+
+void pfs::BlockDevice::readBatch(const std::vector<ReadRequest> &requests) const {
+    for (const auto &request : requests) {
+        read(request.address, request.buffer, request.length);
+    }
+}
+
+void pfs::BlockDevice::writeBatch(const std::vector<WriteRequest> &requests) {
+    for (const auto &request : requests) {
+        write(request.address, request.buffer, request.length);
+    }
+}
+
+void pfs::BlockDevice::readCluster(const int32_t cluster, void *buffer) const {
+    read(clusterAddress(cluster), buffer, fs::Superblock::CLUSTER_SIZE);
+}
+
+void pfs::BlockDevice::writeCluster(const int32_t cluster, const void *buffer) {
+    write(clusterAddress(cluster), buffer, fs::Superblock::CLUSTER_SIZE);
+}
@@ -0,0 +1,143 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_BLOCKDEVICE_H
+#define PRIMITIVE_FS_BLOCKDEVICE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MountOptions.h"
+
+namespace pfs {
+
+    /**
+     * One read request of a batch passed to the device.
+     */
+    struct ReadRequest {
+        /// Address to read from
+        std::size_t address;
+        /// Buffer to read into
+        void* buffer;
+        /// Number of bytes to read
+        std::size_t length;
+    };
+
+    /**
+     * One write request of a batch passed to the device.
+     */
+    struct WriteRequest {
+        /// Address to write to
+        std::size_t address;
+        /// Buffer to write from
+        const void* buffer;
+        /// Number of bytes to write
+        std::size_t length;
+    };
+
+    /**
+     * Block device representing the data file of the file system. Device is opened for the whole time the file system
+     * is mounted and performs positioned reads and writes on the data file, either by byte address or by the number
+     * of a data cluster. Device is shared by all the services manipulating with the data file.
+     */
+    class BlockDevice {
+    private: // private attributes
+        /// Address where the data cluster storage begins
+        std::size_t m_dataStartAddress = 0;
+
+    public: // public methods
+        /**
+         * Opens the data file with given name using given backend. If @a truncate is true, the data file
+         * is created if it does not exist, it's previous content is discarded and it is resized to @a size bytes.
+         *
+         * @param fileName name of the data file
+         * @param backend backend used to access the data file
+         * @param truncate should the data file be created or truncated?
+         * @param size size of the truncated data file
+         * @return opened device
+         * @throw std::ios_base::failure if the data file cannot be opened
+         */
+        static std::shared_ptr<BlockDevice> open(const std::string& fileName, IoBackend backend,
+                                                 bool truncate = false, std::size_t size = 0);
+        BlockDevice() = default;
+        BlockDevice(const BlockDevice& other) = delete;
+        BlockDevice& operator=(const BlockDevice& other) = delete;
+        virtual ~BlockDevice() = default;
+        /**
+         * Sets the address where the data cluster storage begins. Every cluster number passed to this device is
+         * counted from this address.
+         *
+         * @param dataStartAddress start address of the data clusters
+         */
+        void setDataStartAddress(std::size_t dataStartAddress);
+        /// Returns the address where the data cluster storage begins
+        [[nodiscard]] std::size_t getDataStartAddress() const;
+        /**
+         * Returns the byte address of given data cluster.
+         *
+         * @param cluster number of the data cluster
+         * @return address of the cluster in the data file
+         */
+        [[nodiscard]] std::size_t clusterAddress(int32_t cluster) const;
+        /**
+         * Reads @a length bytes from given address into given buffer. Bytes beyond the end of the data file are read as zeros.
+         *
+         * @param address address to read from
+         * @param buffer buffer to read into
+         * @param length number of bytes to read
+         * @throw std::ios_base::failure if the reading fails
+         */
+        virtual void read(std::size_t address, void* buffer, std::size_t length) const = 0;
+        /**
+         * Writes @a length bytes from given buffer at given address.
+         *
+         * @param address address to write to
+         * @param buffer buffer to write from
+         * @param length number of bytes to write
+         * @throw std::ios_base::failure if the writing fails
+         */
+        virtual void write(std::size_t address, const void* buffer, std::size_t length) = 0;
+        /**
+         * Writes @a length zero bytes at given address.
+         *
+         * @param address address to write to
+         * @param length number of zero bytes to write
+         */
+        virtual void zero(std::size_t address, std::size_t length);
+        /**
+         * Performs all given read requests. Requests may be performed in any order and concurrently, so their
+         * buffers must not overlap.
+         *
+         * @param requests requests to perform
+         * @throw std::ios_base::failure if any of the requests fails
+         */
+        virtual void readBatch(const std::vector<ReadRequest>& requests) const;
+        /**
+         * Performs all given write requests. Requests may be performed in any order and concurrently, so their
+         * addresses must not overlap.
+         *
+         * @param requests requests to perform
+         * @throw std::ios_base::failure if any of the requests fails
+         */
+        virtual void writeBatch(const std::vector<WriteRequest>& requests);
+        /// Reads whole data cluster with given number into given buffer of @a fs::Superblock::CLUSTER_SIZE bytes
+        void readCluster(int32_t cluster, void* buffer) const;
+        /// Writes whole data cluster with given number from given buffer of @a fs::Superblock::CLUSTER_SIZE bytes
+        void writeCluster(int32_t cluster, const void* buffer);
+        /**
+         * Forces all written data to the underlying storage.
+         */
+        virtual void sync() = 0;
+        /**
+         * Returns the size of the data file in bytes.
+         *
+         * @return size of the data file
+         */
+        [[nodiscard]] virtual std::size_t size() const = 0;
+    };
+}
+
+#endif //PRIMITIVE_FS_BLOCKDEVICE_H
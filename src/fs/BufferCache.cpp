@@ -0,0 +1,229 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <algorithm>
+#include <vector>
+#include "BufferCache.h"
+
+pfs::BufferCache::BufferCache(std::shared_ptr<BlockDevice> device, const std::size_t capacity)
+                        : m_device(std::move(device)), m_capacity(std::max<std::size_t>(capacity, 1)),
+                        m_deviceSize(m_device->size()) {
+    setDataStartAddress(m_device->getDataStartAddress());
+}
+
+pfs::BufferCache::~BufferCache() {
+    try {
+        flush();
+    } catch (const std::exception& ex) {
+        std::cout << "Chyba při zápisu vyrovnávací paměti: " << ex.what() << '\n';
+    }
+}
+
+void pfs::BufferCache::read(std::size_t address, void *buffer, std::size_t length) const {
+    auto* position = static_cast<char*>(buffer);
+    while (length > 0) {
+        int64_t index = blockIndex(address);
+        std::size_t offset = static_cast<int64_t>(address) - blockAddress(index);
+        std::size_t chunk = std::min(length, fs::Superblock::CLUSTER_SIZE - offset);
+
+        const Block& block = getBlock(index, false);
+        std::memcpy(position, block.data.data() + offset, chunk);
+
+        position += chunk;
+        address += chunk;
+        length -= chunk;
+    }
+}
+
+void pfs::BufferCache::write(std::size_t address, const void *buffer, std::size_t length) {
+    const auto* position = static_cast<const char*>(buffer);
+    while (length > 0) {
+        int64_t index = blockIndex(address);
+        std::size_t offset = static_cast<int64_t>(address) - blockAddress(index);
+        std::size_t chunk = std::min(length, fs::Superblock::CLUSTER_SIZE - offset);
+
+        /// When the whole block is overwritten, there is no need to read it from the device first
+        Block& block = getBlock(index, chunk == fs::Superblock::CLUSTER_SIZE);
+        std::memcpy(block.data.data() + offset, position, chunk);
+        block.dirty = true;
+
+        position += chunk;
+        address += chunk;
+        length -= chunk;
+    }
+}
+
+void pfs::BufferCache::readBatch(const std::vector<ReadRequest> &requests) const {
+    std::vector<ReadRequest> uncached;
+    for (const auto &request : requests) {
+        std::size_t address = request.address;
+        auto* position = static_cast<char*>(request.buffer);
+        std::size_t length = request.length;
+        while (length > 0) {
+            int64_t index = blockIndex(address);
+            std::size_t offset = static_cast<int64_t>(address) - blockAddress(index);
+            std::size_t chunk = std::min(length, fs::Superblock::CLUSTER_SIZE - offset);
+
+            if (const Block* block = findBlock(index)) {
+                std::memcpy(position, block->data.data() + offset, chunk);
+            } else {
+                /// Blocks read around the cache are missed lookups as well
+                m_misses++;
+                if (!uncached.empty() && uncached.back().address + uncached.back().length == address
+                    && static_cast<char*>(uncached.back().buffer) + uncached.back().length == position) {
+                    /// Neighbouring uncached blocks are read at once
+                    uncached.back().length += chunk;
+                } else {
+                    uncached.push_back({ address, position, chunk });
+                }
+            }
+
+            position += chunk;
+            address += chunk;
+            length -= chunk;
+        }
+    }
+
+    m_device->readBatch(uncached);
+}
+
+void pfs::BufferCache::writeBatch(const std::vector<WriteRequest> &requests) {
+    std::vector<WriteRequest> uncached;
+    for (const auto &request : requests) {
+        std::size_t address = request.address;
+        const auto* position = static_cast<const char*>(request.buffer);
+        std::size_t length = request.length;
+        while (length > 0) {
+            int64_t index = blockIndex(address);
+            std::size_t offset = static_cast<int64_t>(address) - blockAddress(index);
+            std::size_t chunk = std::min(length, fs::Superblock::CLUSTER_SIZE - offset);
+
+            if (Block* block = findBlock(index)) {
+                std::memcpy(block->data.data() + offset, position, chunk);
+                block->dirty = true;
+            } else if (!uncached.empty() && uncached.back().address + uncached.back().length == address
+                       && static_cast<const char*>(uncached.back().buffer) + uncached.back().length == position) {
+                /// Neighbouring uncached blocks are written at once
+                uncached.back().length += chunk;
+            } else {
+                uncached.push_back({ address, position, chunk });
+            }
+
+            position += chunk;
+            address += chunk;
+            length -= chunk;
+        }
+    }
+
+    m_device->writeBatch(uncached);
+}
+
+void pfs::BufferCache::sync() {
+    flush();
+    m_device->sync();
+}
+
+std::size_t pfs::BufferCache::size() const {
+    return m_deviceSize;
+}
+
+void pfs::BufferCache::flush() {
+    std::vector<Block*> dirtyBlocks;
+    for (auto &block : m_blocks) {
+        if (block.dirty) {
+            dirtyBlocks.push_back(&block);
+        }
+    }
+
+    /// Writing back in the order of addresses, so the device is accessed sequentially
+    std::sort(dirtyBlocks.begin(), dirtyBlocks.end(), [](const Block* first, const Block* second) {
+        return first->index < second->index;
+    });
+    for (const auto &block : dirtyBlocks) {
+        writeBack(*block);
+    }
+}
+
+pfs::CacheStatistics pfs::BufferCache::getStatistics() const {
+    CacheStatistics statistics;
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+    statistics.cached = m_blocks.size();
+    statistics.capacity = m_capacity;
+    statistics.dirty = std::count_if(m_blocks.begin(), m_blocks.end(), [](const Block& block) { return block.dirty; });
+    return statistics;
+}
+
+int64_t pfs::BufferCache::blockIndex(const std::size_t address) const {
+    auto offset = static_cast<int64_t>(address) - static_cast<int64_t>(getDataStartAddress());
+    auto clusterSize = static_cast<int64_t>(fs::Superblock::CLUSTER_SIZE);
+    /// Rounding down even for metadata in front of the cluster storage
+    return (offset >= 0) ? (offset / clusterSize) : -((-offset + clusterSize - 1) / clusterSize);
+}
+
+int64_t pfs::BufferCache::blockAddress(const int64_t index) const {
+    return static_cast<int64_t>(getDataStartAddress()) + (index * static_cast<int64_t>(fs::Superblock::CLUSTER_SIZE));
+}
+
+pfs::BufferCache::Block &pfs::BufferCache::getBlock(const int64_t index, const bool overwrite) const {
+    if (Block* cached = findBlock(index)) {
+        return *cached;
+    }
+
+    m_misses++;
+    m_blocks.emplace_front();
+    Block& block = m_blocks.front();
+    block.index = index;
+    block.dirty = false;
+    if (!overwrite) {
+        int64_t address = blockAddress(index);
+        if (address < 0) {
+            /// First metadata block starts in front of the data file
+            std::memset(block.data.data(), 0, -address);
+            m_device->read(0, block.data.data() - address, fs::Superblock::CLUSTER_SIZE + address);
+        } else {
+            m_device->read(address, block.data.data(), fs::Superblock::CLUSTER_SIZE);
+        }
+    }
+    m_blockIndex[index] = m_blocks.begin();
+
+    evict();
+    return block;
+}
+
+pfs::BufferCache::Block *pfs::BufferCache::findBlock(const int64_t index) const {
+    auto it = m_blockIndex.find(index);
+    if (it == m_blockIndex.end()) {
+        return nullptr;
+    }
+
+    m_hits++;
+    /// Moving the block to the front of the LRU list
+    m_blocks.splice(m_blocks.begin(), m_blocks, it->second);
+    return &m_blocks.front();
+}
+
+void pfs::BufferCache::writeBack(Block &block) const {
+    if (!block.dirty) {
+        return;
+    }
+
+    int64_t address = blockAddress(block.index);
+    int64_t offset = (address < 0) ? -address : 0;
+    /// First metadata block starts in front of the data file, last data block may end behind it
+    int64_t end = std::min<int64_t>(fs::Superblock::CLUSTER_SIZE, static_cast<int64_t>(m_deviceSize) - address);
+    if (end > offset) {
+        m_device->write(address + offset, block.data.data() + offset, end - offset);
+    }
+    block.dirty = false;
+}
+
+void pfs::BufferCache::evict() const {
+    while (m_blocks.size() > m_capacity) {
+        Block& block = m_blocks.back();
+        writeBack(block);
+        m_blockIndex.erase(block.index);
+        m_blocks.pop_back();
+    }
+}
@@ -0,0 +1,128 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_BUFFERCACHE_H
+#define PRIMITIVE_FS_BUFFERCACHE_H
+
+#include <array>
+#include <list>
+#include <unordered_map>
+#include "BlockDevice.h"
+#include "../common/structures.h"
+
+namespace pfs {
+
+    /**
+     * Statistics of a cache, either the buffer cache of blocks, the i-node cache or the cache of directory items.
+     */
+    struct CacheStatistics {
+        /// Number of lookups served from the cache
+        std::size_t hits = 0;
+        /// Number of lookups that had to be read from the device
+        std::size_t misses = 0;
+        /// Number of currently cached entries
+        std::size_t cached = 0;
+        /// Maximal number of cached entries
+        std::size_t capacity = 0;
+        /// Number of cached entries not written back yet
+        std::size_t dirty = 0;
+    };
+
+    /**
+     * Write-back buffer cache with fixed budget sitting on top of another block device. Data file is cached in blocks
+     * of @a fs::Superblock::CLUSTER_SIZE bytes aligned to the start of the data cluster storage, so block with index @a n
+     * is exactly the data cluster @a n. Metadata in front of the cluster storage are cached in blocks with negative indexes.
+     * When the budget is exceeded, least recently used block is evicted. Modified blocks are written back to the
+     * underlying device on eviction, on @a flush and when the cache is destroyed.
+     */
+    class BufferCache : public BlockDevice {
+    private: // private attributes
+        /**
+         * One cached block.
+         */
+        struct Block {
+            /// Index of the block
+            int64_t index;
+            /// Was the block modified since it was read from the device?
+            bool dirty;
+            /// Cached data
+            std::array<char, fs::Superblock::CLUSTER_SIZE> data;
+        };
+
+        /// Device to cache
+        std::shared_ptr<BlockDevice> m_device;
+        /// Maximal number of cached blocks
+        std::size_t m_capacity;
+        /// Size of the cached device, blocks are never written back behind it
+        std::size_t m_deviceSize;
+        /// Cached blocks, most recently used at the front
+        mutable std::list<Block> m_blocks;
+        /// Cached blocks by their index
+        mutable std::unordered_map<int64_t, std::list<Block>::iterator> m_blockIndex;
+        /// Number of lookups served from the cache
+        mutable std::size_t m_hits = 0;
+        /// Number of lookups read from the device
+        mutable std::size_t m_misses = 0;
+
+    public: // public methods
+        /**
+         * Creates a cache on top of given device. Address of the data cluster storage has to be already set to the device.
+         *
+         * @param device device to cache
+         * @param capacity maximal number of cached blocks
+         */
+        BufferCache(std::shared_ptr<BlockDevice> device, std::size_t capacity);
+        /**
+         * Writes all modified blocks back to the underlying device.
+         */
+        ~BufferCache() override;
+
+        void read(std::size_t address, void* buffer, std::size_t length) const override;
+        void write(std::size_t address, const void* buffer, std::size_t length) override;
+        /**
+         * Performs given read requests. Parts of the requests already cached are copied from the cache, the rest is read
+         * from the underlying device as one batch without being cached, so bulk reads don't evict the working set.
+         */
+        void readBatch(const std::vector<ReadRequest>& requests) const override;
+        /**
+         * Performs given write requests. Parts of the requests already cached are written into the cache, the rest is
+         * written to the underlying device as one batch without being cached, so bulk writes don't evict the working set.
+         */
+        void writeBatch(const std::vector<WriteRequest>& requests) override;
+        /**
+         * Writes all modified blocks back to the underlying device and forces them to the storage.
+         */
+        void sync() override;
+        [[nodiscard]] std::size_t size() const override;
+        /**
+         * Writes all modified blocks back to the underlying device. Blocks stay cached.
+         */
+        void flush();
+        /**
+         * Returns current statistics of this cache.
+         *
+         * @return cache statistics
+         */
+        [[nodiscard]] CacheStatistics getStatistics() const;
+
+    private: // private methods
+        /// Returns index of the block containing given address
+        [[nodiscard]] int64_t blockIndex(std::size_t address) const;
+        /// Returns address of the first byte of given block, may be negative for the first metadata block
+        [[nodiscard]] int64_t blockAddress(int64_t index) const;
+        /**
+         * Returns cached block with given index. If the block is not cached, it is read from the device, unless
+         * @a overwrite is true, meaning the whole block is going to be overwritten anyway.
+         */
+        Block& getBlock(int64_t index, bool overwrite) const;
+        /// Returns cached block with given index moved to the front of the LRU list, or null if the block is not cached
+        Block* findBlock(int64_t index) const;
+        /// Writes given block back to the device
+        void writeBack(Block& block) const;
+        /// Evicts least recently used blocks until the budget is met
+        void evict() const;
+    };
+}
+
+#endif //PRIMITIVE_FS_BUFFERCACHE_H
@@ -2,544 +2,1021 @@
 // Created by markovda on 24.01.21.
 //
 
+#include <algorithm>
 #include "DataService.h"
 
-pfs::DataService::DataService(std::string dataFileName, fs::Bitmap dataBitmap, int32_t dataBitmapAddress,
-                              int32_t dataStartAddress) : m_dataFileName(std::move(dataFileName)),
-                              m_dataBitmap(std::move(dataBitmap)), m_dataBitmapAddress(dataBitmapAddress),
-                              m_dataStartAddress(dataStartAddress) {}
+namespace {
+    /**
+     * Size of the header of an extent tree block, holding the depth of the block and the number of it's entries.
+     * Entries of leaf blocks (depth 0) are extents, entries of index blocks are pairs of the first cluster
+     * of the file mapped by the child and the link to the child.
+     */
+    constexpr std::size_t EXTENT_BLOCK_HEADER_SIZE = 2 * sizeof(int32_t);
+
+    /// Stores given entry of an extent tree block
+    void encodeExtentEntry(u_char* block, const std::size_t entry, const int32_t first, const int32_t second) {
+        u_char* record = block + EXTENT_BLOCK_HEADER_SIZE + (entry * sizeof(fs::Extent));
+        fs::encodeInt32(record, first);
+        fs::encodeInt32(record + sizeof(int32_t), second);
+    }
+
+    /// Loads extents from given leaf block of an extent tree
+    void decodeExtentLeaf(const u_char* block, std::vector<fs::Extent>& extents) {
+        std::size_t count = std::min<std::size_t>(std::max(fs::decodeInt32(block + sizeof(int32_t)), 0),
+                                                  fs::Inode::EXTENTS_IN_BLOCK);
+        for (std::size_t entry = 0; entry < count; ++entry) {
+            const u_char* record = block + EXTENT_BLOCK_HEADER_SIZE + (entry * sizeof(fs::Extent));
+            extents.push_back({ fs::decodeInt32(record), fs::decodeInt32(record + sizeof(int32_t)) });
+        }
+    }
+
+    /// Stores given link into given entry of a block of links
+    void encodeLink(u_char* block, const std::size_t entry, const int32_t link) {
+        fs::encodeInt32(block + (entry * sizeof(int32_t)), link);
+    }
+
+    /// Loads the link stored in given entry of a block of links
+    int32_t decodeLink(const u_char* block, const std::size_t entry) {
+        return fs::decodeInt32(block + (entry * sizeof(int32_t)));
+    }
+
+    /// Sets every entry of given block of links empty
+    void encodeEmptyLinks(u_char* block) {
+        for (std::size_t entry = 0; entry < fs::Inode::LINKS_IN_INDIRECT; ++entry) {
+            encodeLink(block, entry, fs::EMPTY_LINK);
+        }
+    }
+}
+
+pfs::DataService::DataService(std::shared_ptr<pfs::BlockDevice> device, const fs::Superblock& superblock,
+                              pfs::GroupedBitmap dataBitmap) : m_device(std::move(device)),
+                              m_dataBitmap(std::move(dataBitmap)),
+                              m_dataBitmapAddress(superblock.getDataBitmapStartAddress()),
+                              m_inodesPerGroup(superblock.getInodesPerGroup()),
+                              m_groupCount(superblock.getGroupCount()),
+                              m_inodeGroupCount(superblock.getInodeGroupCount()),
+                              m_initializedClusterCount(superblock.getInitializedClusterCount()),
+                              m_initializedClusterCountAddress(fs::Superblock::INITIALIZED_CLUSTER_COUNT_OFFSET) {}
 
 std::vector<fs::DirectoryItem> pfs::DataService::getDirectoryItems(const fs::Inode& directory) const {
     if (!directory.isDirectory()) {
         throw std::invalid_argument("Předaný i-uzel musí být složka!");
     }
-    return readDirItems(getAllDirectLinks(directory));
+
+    /// The first cluster and all the buckets behind it are read as one batch
+    std::vector<int32_t> clusters = getAllDirectLinks(directory);
+    std::vector<u_char> data(clusters.size() * fs::Superblock::CLUSTER_SIZE);
+    std::vector<pfs::ReadRequest> requests;
+    for (std::size_t i = 0; i < clusters.size(); ++i) {
+        requests.push_back({ m_device->clusterAddress(clusters[i]), data.data() + (i * fs::Superblock::CLUSTER_SIZE),
+                             fs::Superblock::CLUSTER_SIZE });
+    }
+    m_device->readBatch(requests);
+
+    std::vector<fs::DirectoryItem> directoryItems(2);
+    directoryItems[0].decode(data.data());
+    directoryItems[1].decode(data.data() + fs::DirectoryItem::DISK_SIZE);
+    fs::DirectoryBucket bucket;
+    for (std::size_t i = 1; i < clusters.size(); ++i) {
+        bucket.decode(data.data() + (i * fs::Superblock::CLUSTER_SIZE));
+        for (const auto &item : bucket.getItems()) {
+            if (!item.isFree()) {
+                directoryItems.push_back(item);
+            }
+        }
+    }
+    return directoryItems;
+}
+
+std::size_t pfs::DataService::getDirectoryBlockCount(const fs::Inode &directory) const {
+    if (!directory.isDirectory()) {
+        throw std::invalid_argument("Předaný i-uzel musí být složka!");
+    }
+
+    return 1 + readDirectoryHeader(directory).getBucketCount();
+}
+
+fs::DirectoryBucket pfs::DataService::readDirectoryBlock(const fs::Inode &directory, const std::size_t position) const {
+    if (position > 0) {
+        return readBucket(getDirectoryBlock(directory, position));
+    }
+
+    fs::DirectoryBucket items;
+    std::array<u_char, 2 * fs::DirectoryItem::DISK_SIZE> data {};
+    m_device->read(m_device->clusterAddress(directory.getDirectLinks()[0]), data.data(), data.size());
+    for (std::size_t slot = 0; slot < 2; ++slot) {
+        fs::DirectoryItem item;
+        item.decode(data.data() + (slot * fs::DirectoryItem::DISK_SIZE));
+        items.setItem(slot, item);
+    }
+    return items;
 }
 
 std::vector<int32_t> pfs::DataService::getAllDirectLinks(const fs::Inode &inode) const {
-    std::vector<int32_t> directLinks;
+    std::vector<int32_t> indirectLinks;
+    return readLinkTrees(inode, indirectLinks);
+}
 
+std::vector<int32_t> pfs::DataService::readLinkTrees(const fs::Inode &inode, std::vector<int32_t> &indirectLinks) const {
+    /// Links in the order of the file data with the depth of their trees, data blocks having depth 0
+    using Link = std::pair<int32_t, std::size_t>;
+    std::vector<Link> links;
     for (const auto &directLink : inode.getDirectLinks()) {
-        if (directLink != fs::EMPTY_LINK) {
-            directLinks.push_back(directLink);
-        }
+        links.emplace_back(directLink, 0);
     }
-
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při čtení dat");
+    for (std::size_t tree = 0; tree < fs::DataLinks::TREE_DEPTHS.size(); ++tree) {
+        links.emplace_back(inode.getTreeLink(tree), fs::DataLinks::TREE_DEPTHS[tree]);
     }
 
-    for (const auto &indirectLink : inode.getIndirectLinks()) {
-        if (indirectLink == fs::EMPTY_LINK) {
-            continue;
+    /// Every level of the trees is read as one batch, replacing the blocks of links by the links they hold
+    while (true) {
+        std::vector<Link> expanded;
+        std::vector<std::size_t> blockPositions;
+        for (const auto &[link, depth] : links) {
+            if (link == fs::EMPTY_LINK) {
+                continue;
+            }
+            if (depth > 0) {
+                blockPositions.push_back(expanded.size());
+                indirectLinks.push_back(link);
+            }
+            expanded.emplace_back(link, depth);
+        }
+        if (blockPositions.empty()) {
+            links = std::move(expanded);
+            break;
+        }
+
+        std::vector<u_char> blocks(blockPositions.size() * fs::Superblock::CLUSTER_SIZE);
+        std::vector<pfs::ReadRequest> requests;
+        for (std::size_t i = 0; i < blockPositions.size(); ++i) {
+            requests.push_back({ m_device->clusterAddress(expanded[blockPositions[i]].first),
+                                 blocks.data() + (i * fs::Superblock::CLUSTER_SIZE), fs::Superblock::CLUSTER_SIZE });
         }
+        m_device->readBatch(requests);
+
+        links.clear();
+        for (std::size_t i = 0, block = 0; i < expanded.size(); ++i) {
+            if (expanded[i].second == 0) {
+                links.push_back(expanded[i]);
+                continue;
+            }
 
-        for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(int32_t)) {
-            int32_t directLink;
-            dataFile.seekg(m_dataStartAddress + (indirectLink * fs::Superblock::CLUSTER_SIZE) + i, std::ios_base::beg);
-            dataFile.read((char*)&directLink, sizeof(directLink));
-            if (directLink != fs::EMPTY_LINK) {
-                directLinks.push_back(directLink);
+            const u_char* blockLinks = blocks.data() + (block++ * fs::Superblock::CLUSTER_SIZE);
+            for (std::size_t j = 0; j < fs::Inode::LINKS_IN_INDIRECT; ++j) {
+                links.emplace_back(decodeLink(blockLinks, j), expanded[i].second - 1);
             }
         }
     }
 
+    std::vector<int32_t> directLinks;
+    for (const auto &[link, depth] : links) {
+        directLinks.push_back(link);
+    }
     return directLinks;
 }
 
-int32_t pfs::DataService::getFreeDataBlock() const {
-    return m_dataBitmap.findFirstFreeIndex();
+int32_t pfs::DataService::allocateDataBlock(const fs::Inode& owner) {
+    return m_dataBitmap.allocateIndex(getGroup(owner));
 }
 
-std::vector<int32_t> pfs::DataService::getFreeDataBlocks(const std::size_t count) const {
-    return m_dataBitmap.findFreeIndexes(count);
-}
+std::vector<int32_t> pfs::DataService::allocateDataBlocks(const std::size_t count, const fs::Inode& owner) {
+    if (count == 0 || count > m_dataBitmap.getFreeCount()) {
+        throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných datových bloků");
+    }
 
-void pfs::DataService::saveFileData(const fs::ClusteredFileData& clusteredData, const std::vector<int32_t>& dataClusterIndexes) {
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru");
-    }
-
-    std::size_t cluster = fs::Inode::DIRECT_LINKS_COUNT;
-    std::size_t processedLinksInIndirect = fs::Inode::LINKS_IN_INDIRECT;
-    int32_t currentIndirectLink;
-    for (int i = 0; i < dataClusterIndexes.size(); ++i) {
-        if (i < fs::Inode::DIRECT_LINKS_COUNT) {
-            m_dataBitmap.setIndexFilled(dataClusterIndexes.at(i));
-            dataFile.seekp(m_dataStartAddress + (dataClusterIndexes.at(i) * fs::Superblock::CLUSTER_SIZE), std::ios_base::beg);
-            dataFile.write(clusteredData.at(i).data(), fs::Superblock::CLUSTER_SIZE);
-            dataFile.flush();
-        } else {
-            if (processedLinksInIndirect == fs::Inode::LINKS_IN_INDIRECT) {
-                /// Just saving the indirect index, will be saving there other direct links, is already saved in inode
-                currentIndirectLink = dataClusterIndexes.at(i);
-                dataFile.seekg(m_dataStartAddress + (currentIndirectLink * fs::Superblock::CLUSTER_SIZE));
-                for (int j = 0; j < fs::Superblock::CLUSTER_SIZE; ++j) {
-                    dataFile.put(fs::EMPTY_LINK);
-                }
-                m_dataBitmap.setIndexFilled(currentIndirectLink);
-                processedLinksInIndirect = 0;
-            } else {
-                /// Saving the direct data
-                m_dataBitmap.setIndexFilled(dataClusterIndexes.at(i));
-                dataFile.seekp(m_dataStartAddress +
-                               dataClusterIndexes.at(i) * fs::Superblock::CLUSTER_SIZE, std::ios_base::beg);
-                dataFile.write(clusteredData.at(cluster).data(), clusteredData.at(cluster).length());
-                dataFile.flush();
-                /// Saving a link to direct data to indirect data cluster
-                dataFile.seekp(m_dataStartAddress + (currentIndirectLink * fs::Superblock::CLUSTER_SIZE)
-                               + (processedLinksInIndirect * sizeof(int32_t)), std::ios_base::beg);
-                dataFile.write((char*)&dataClusterIndexes.at(i), sizeof(int32_t));
-                dataFile.flush();
-                /// Incrementing needed variables
-                cluster++;
-                processedLinksInIndirect++;
-            }
+    std::vector<pfs::GroupedBitmap::Run> fragments(m_dataBitmap.allocateRuns(count, getGroup(owner)));
+    std::vector<int32_t> blocks;
+    for (const auto &[start, length] : fragments) {
+        for (std::size_t i = 0; i < length; ++i) {
+            blocks.push_back(start + i);
         }
     }
 
-    /// In the end we need to save the changes we made to the bitmap
-    m_dataBitmap.save(dataFile, m_dataBitmapAddress);
+    /// Blocks of indirect links are taken from the end, data blocks from the start
+    std::vector<bool> isIndirect(fs::DataLinks::getIndirectBlockMask(count));
+    std::size_t indirectCount = std::count(isIndirect.begin(), isIndirect.end(), true);
+
+    std::vector<int32_t> dataBlockIndexes;
+    auto data = blocks.begin();
+    auto indirect = blocks.end() - indirectCount;
+    for (std::size_t i = 0; i < count; ++i) {
+        dataBlockIndexes.push_back(isIndirect[i] ? *(indirect++) : *(data++));
+    }
+
+    return dataBlockIndexes;
+}
+
+std::size_t pfs::DataService::findEmptiestGroup() const {
+    return m_dataBitmap.findEmptiestGroup();
 }
 
+std::vector<fs::Extent> pfs::DataService::allocateExtents(const std::size_t clusterCount, const fs::Inode &owner,
+                                                          std::vector<int32_t> &treeBlocks) {
+    if (clusterCount == 0 || clusterCount > m_dataBitmap.getFreeCount()) {
+        throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných datových bloků");
+    }
 
-std::vector<fs::DirectoryItem> pfs::DataService::readDirItems(const std::vector<int32_t> &indexList) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při čtení ze souboru");
+    std::vector<fs::Extent> extents;
+    for (const auto &[start, length] : m_dataBitmap.allocateRuns(clusterCount, getGroup(owner))) {
+        extents.push_back({ static_cast<int32_t>(start), static_cast<int32_t>(length) });
     }
 
-    std::vector<fs::DirectoryItem> directoryItems;
+    treeBlocks.clear();
+    if (extents.size() <= fs::Inode::INLINE_EXTENTS_COUNT) {
+        return extents;
+    }
 
-    for (const auto& index : indexList) {
-        for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(fs::DirectoryItem)) {
-            fs::DirectoryItem dirItem;
-            dirItem.load(dataFile, m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE) + i);
-            if (dirItem.getItemName().at(0) != 0) {
-                /// Ending character at the beginning of the file name would mean, that we read "empty" memory
-                directoryItems.push_back(dirItem);
+    try {
+        std::size_t blockCount = getExtentTreeBlockCount(extents.size());
+        for (const auto &[start, length] : m_dataBitmap.allocateRuns(blockCount, getGroup(owner))) {
+            for (std::size_t i = 0; i < length; ++i) {
+                treeBlocks.push_back(start + i);
+            }
+        }
+    } catch (const std::exception &ex) {
+        /// Releasing the data clusters, the file can't be mapped
+        for (const auto &extent : extents) {
+            for (int32_t i = 0; i < extent.length; ++i) {
+                m_dataBitmap.setIndexFree(extent.start + i);
             }
         }
+        throw;
     }
 
-    return directoryItems;
+    return extents;
 }
 
-void pfs::DataService::saveDirItemIntoDirectory(const fs::DirectoryItem &directoryItem, fs::Inode& directory) {
-    if (!directory.isDirectory()) {
-        throw std::invalid_argument("Předaný i-uzel musí být složka!");
+std::vector<fs::Extent> pfs::DataService::getDataExtents(const fs::Inode &inode) const {
+    std::vector<fs::Extent> extents;
+    if (inode.hasInlineData()) {
+        return extents;
+    }
+    if (!inode.usesExtents()) {
+        for (const auto &link : getAllDirectLinks(inode)) {
+            if (!extents.empty() && extents.back().start + extents.back().length == link) {
+                extents.back().length++;
+            } else {
+                extents.push_back({ link, 1 });
+            }
+        }
+        return extents;
     }
 
-    int32_t addressToStoreTo = directory.getLastFilledDirectLinkValue();
-    if (addressToStoreTo == fs::EMPTY_LINK) {
-        /**
-         * Every index is free, we store to any free data block
-         */
-        saveDirItemToFreeDirectLink(directoryItem, directory);
-        return;
+    if (inode.getExtentTreeLink() != fs::EMPTY_LINK) {
+        std::vector<int32_t> treeBlocks;
+        return readExtentTree(inode.getExtentTreeLink(), treeBlocks);
     }
 
-    /// First we need to check if there is any free space in the last filled data block
-    size_t indexInCluster = getFreeDirItemDataBlockSubindex(addressToStoreTo);
-    if (indexInCluster < fs::Superblock::CLUSTER_SIZE) {
-        /// We found free space in direct link and save there
-        saveDirItemToAddress(directoryItem, m_dataStartAddress + (addressToStoreTo * fs::Superblock::CLUSTER_SIZE) + indexInCluster);
-    } else {
-        /// Entire direct link is full, we save into next direct or indirect
-        if (directory.getFirstFreeDirectLink() < directory.getDirectLinks().size()) {
-            /// There is free direct link, so we store directly and add direct link
-            saveDirItemToFreeDirectLink(directoryItem, directory);
-        } else {
-            /// Every direct link is filled, we store to indirect link
-            saveDirItemToIndirect(directoryItem, directory);
+    for (const auto &extent : inode.getInlineExtents()) {
+        if (extent.length > 0) {
+            extents.push_back(extent);
         }
     }
-
+    return extents;
 }
 
-bool pfs::DataService::saveDirItemToFreeDirectLink(const fs::DirectoryItem& directoryItem, fs::Inode& directory) {
-    int32_t addressToStoreTo = getFreeDataBlock();
+std::size_t pfs::DataService::getFragmentCount(const fs::Inode &inode) const {
+    return getDataExtents(inode).size();
+}
 
-    saveDirItemToIndex(directoryItem, addressToStoreTo);
-    return directory.addDirectLink(addressToStoreTo);
+void pfs::DataService::saveFileData(const fs::ClusteredFileData& clusteredData, const std::vector<int32_t>& dataClusterIndexes) {
+    /// Blocks of links are built in memory and written whole, list keeps their addresses stable
+    std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> indirectClusters;
+    /// Every cluster is written as one batch in the end, so the device may merge the adjacent ones
+    std::vector<pfs::WriteRequest> writes;
+    std::size_t cluster = 0;
+    addLinkWrites(writes, indirectClusters, dataClusterIndexes, [&](const int32_t link) {
+        addDataClusterWrites(writes, link, clusteredData.at(cluster++));
+    });
+    m_device->writeBatch(writes);
 }
 
-void pfs::DataService::saveDirItemToIndex(const fs::DirectoryItem &directoryItem, const int32_t index) {
-    int32_t address = m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE);
-    saveDirItemToAddress(directoryItem, address);
+void pfs::DataService::saveFileData(std::istream &stream, const std::size_t size,
+                                    const std::vector<int32_t> &dataClusterIndexes) {
+    std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> indirectClusters;
+    std::vector<pfs::WriteRequest> writes;
+    /// Data blocks are collected as runs of adjacent clusters, the blocks of links take only a fraction of the data
+    std::vector<fs::Extent> runs;
+    addLinkWrites(writes, indirectClusters, dataClusterIndexes, [&](const int32_t link) {
+        if (!runs.empty() && runs.back().start + runs.back().length == link) {
+            runs.back().length++;
+        } else {
+            runs.push_back({ link, 1 });
+        }
+    });
+    m_device->writeBatch(writes);
+    saveStreamData(stream, size, runs);
+}
 
-    /// When saving to new cluster, we need to make sure every other bit of memory is set to 0 (empty) for future i/o operations
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru");
+void pfs::DataService::addLinkWrites(std::vector<pfs::WriteRequest> &writes,
+                                     std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> &indirectClusters,
+                                     const std::vector<int32_t> &dataClusterIndexes,
+                                     const std::function<void(int32_t)> &addDataCluster) {
+    auto next = dataClusterIndexes.begin();
+    for (std::size_t i = 0; i < fs::Inode::DIRECT_LINKS_COUNT && next != dataClusterIndexes.end(); ++i) {
+        addLinkTreeWrites(writes, indirectClusters, 0, next, dataClusterIndexes.end(), addDataCluster);
+    }
+    for (std::size_t depth : fs::DataLinks::TREE_DEPTHS) {
+        if (next == dataClusterIndexes.end()) {
+            break;
+        }
+        addLinkTreeWrites(writes, indirectClusters, depth, next, dataClusterIndexes.end(), addDataCluster);
     }
-    dataFile.seekp(address + sizeof(directoryItem), std::ios_base::beg);
-    for (int i = sizeof(directoryItem); i < fs::Superblock::CLUSTER_SIZE; ++i) {
-        dataFile.put('\0');
+}
+
+void pfs::DataService::addLinkTreeWrites(std::vector<pfs::WriteRequest> &writes,
+                                         std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> &indirectClusters,
+                                         const std::size_t depth, std::vector<int32_t>::const_iterator &next,
+                                         const std::vector<int32_t>::const_iterator &end,
+                                         const std::function<void(int32_t)> &addDataCluster) {
+    int32_t link = *(next++);
+    if (depth == 0) {
+        addDataCluster(link);
+        return;
     }
-    dataFile.flush();
 
-    m_dataBitmap.setIndexFilled(index);
-    m_dataBitmap.save(dataFile, m_dataBitmapAddress);
+    auto& indirectCluster = indirectClusters.emplace_back();
+    encodeEmptyLinks(indirectCluster.data());
+    writes.push_back({ m_device->clusterAddress(link), indirectCluster.data(), fs::Superblock::CLUSTER_SIZE });
+    claimCluster(link);
+    for (std::size_t i = 0; i < fs::Inode::LINKS_IN_INDIRECT && next != end; ++i) {
+        encodeLink(indirectCluster.data(), i, *next);
+        addLinkTreeWrites(writes, indirectClusters, depth - 1, next, end, addDataCluster);
+    }
 }
 
-void pfs::DataService::saveDirItemToAddress(const fs::DirectoryItem& directoryItem, const int32_t address) const {
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru");
+void pfs::DataService::saveFileData(const fs::ClusteredFileData &clusteredData, const std::vector<fs::Extent> &extents,
+                                    const std::vector<int32_t> &treeBlocks, fs::Inode &inode) {
+    /// Every cluster is written as one batch in the end, so the device may merge the adjacent ones
+    std::vector<pfs::WriteRequest> writes;
+    std::size_t cluster = 0;
+    for (const auto &extent : extents) {
+        for (int32_t i = 0; i < extent.length; ++i) {
+            addDataClusterWrites(writes, extent.start + i, clusteredData.at(cluster++));
+        }
     }
 
-    directoryItem.save(dataFile, address);
+    /// Blocks of the tree are built in memory, list keeps their addresses stable
+    std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> treeClusters;
+    if (treeBlocks.empty()) {
+        inode.setExtents(extents);
+    } else {
+        addExtentTreeWrites(writes, treeClusters, extents, treeBlocks);
+        inode.setExtentTree(treeBlocks.front());
+    }
+    m_device->writeBatch(writes);
 }
 
-size_t pfs::DataService::getFreeDirItemDataBlockSubindex(const int32_t dirItemDataBlockSubindex) const {
-    std::ifstream dataFileR(m_dataFileName, std::ios::in | std::ios::app);
-    if (!dataFileR) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru");
+void pfs::DataService::saveFileData(std::istream &stream, const std::size_t size, const std::vector<fs::Extent> &extents,
+                                    const std::vector<int32_t> &treeBlocks, fs::Inode &inode) {
+    /// The mapping is written first, so the clusters can be freed through the inode if the stream fails
+    std::vector<pfs::WriteRequest> writes;
+    std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> treeClusters;
+    if (treeBlocks.empty()) {
+        inode.setExtents(extents);
+    } else {
+        addExtentTreeWrites(writes, treeClusters, extents, treeBlocks);
+        inode.setExtentTree(treeBlocks.front());
     }
+    m_device->writeBatch(writes);
+    saveStreamData(stream, size, extents);
+}
+
+void pfs::DataService::saveStreamData(std::istream &stream, std::size_t size, const std::vector<fs::Extent> &runs) {
+    std::vector<char> buffer(STREAM_BUFFER_CLUSTERS * fs::Superblock::CLUSTER_SIZE);
+    for (const auto &run : runs) {
+        for (int32_t written = 0; written < run.length;) {
+            std::size_t count = std::min<std::size_t>(run.length - written, STREAM_BUFFER_CLUSTERS);
+            std::size_t length = std::min(count * fs::Superblock::CLUSTER_SIZE, size);
+            stream.read(buffer.data(), static_cast<std::streamsize>(length));
+            if (static_cast<std::size_t>(stream.gcount()) != length) {
+                throw std::ios_base::failure("Chyba při čtení importovaného souboru");
+            }
+
+            int32_t first = run.start + written;
+            std::size_t writeLength = length;
+            if (claimCluster(first + static_cast<int32_t>(count) - 1) && length < count * fs::Superblock::CLUSTER_SIZE) {
+                /// Rest of the last cluster may still hold data of a removed file
+                std::fill(buffer.begin() + static_cast<std::ptrdiff_t>(length),
+                          buffer.begin() + static_cast<std::ptrdiff_t>(count * fs::Superblock::CLUSTER_SIZE), 0);
+                writeLength = count * fs::Superblock::CLUSTER_SIZE;
+            }
+            m_device->write(m_device->clusterAddress(first), buffer.data(), writeLength);
 
-    size_t indexInCluster = 0;
-    size_t offset = m_dataStartAddress + (dirItemDataBlockSubindex * fs::Superblock::CLUSTER_SIZE);
-    while (indexInCluster < fs::Superblock::CLUSTER_SIZE) {
-        fs::DirectoryItem dirItem;
-        dirItem.load(dataFileR, offset + indexInCluster);
-        if (dirItem.getItemName()[0] == '\0') {
-            return indexInCluster;
+            size -= length;
+            written += static_cast<int32_t>(count);
         }
+    }
+}
 
-        indexInCluster += sizeof(fs::DirectoryItem);
+std::size_t pfs::DataService::getExtentTreeBlockCount(const std::size_t extentCount) {
+    std::size_t leafCount = (extentCount + fs::Inode::EXTENTS_IN_BLOCK - 1) / fs::Inode::EXTENTS_IN_BLOCK;
+    if (leafCount > fs::Inode::EXTENTS_IN_BLOCK) {
+        throw pfs::ObjectNotFound("Soubor je příliš roztříštěný, jeho extenty nelze uložit");
     }
 
-    return indexInCluster;
+    /// One leaf is the root itself, more leaves need an index block above them
+    return (leafCount > 1) ? (leafCount + 1) : leafCount;
 }
 
-size_t pfs::DataService::getFreeIndirectLinkDataBlockSubindex(const int32_t indirectLinkDatablockIndex) const {
-    std::ifstream dataFileR(m_dataFileName, std::ios::in | std::ios::app);
-    if (!dataFileR) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru");
-    }
+void pfs::DataService::addExtentTreeWrites(std::vector<pfs::WriteRequest> &writes,
+                                           std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>> &treeClusters,
+                                           const std::vector<fs::Extent> &extents,
+                                           const std::vector<int32_t> &treeBlocks) {
+    /// Leaves are all the blocks behind the root, unless the root is the only leaf
+    std::size_t firstLeaf = (treeBlocks.size() > 1) ? 1 : 0;
+    if (firstLeaf == 1) {
+        auto& root = treeClusters.emplace_back();
+        root.fill(0);
+        fs::encodeInt32(root.data(), 1);
+        fs::encodeInt32(root.data() + sizeof(int32_t), treeBlocks.size() - 1);
+        writes.push_back({ m_device->clusterAddress(treeBlocks.front()), root.data(), root.size() });
+        claimCluster(treeBlocks.front());
+    }
+
+    std::size_t extent = 0;
+    int32_t firstCluster = 0;
+    for (std::size_t block = firstLeaf; block < treeBlocks.size(); ++block) {
+        if (firstLeaf == 1) {
+            encodeExtentEntry(treeClusters.front().data(), block - firstLeaf, firstCluster, treeBlocks[block]);
+        }
 
-    size_t indexInCluster = 0;
-    size_t offset = m_dataStartAddress + (indirectLinkDatablockIndex * fs::Superblock::CLUSTER_SIZE);
-    while (indexInCluster < fs::Superblock::CLUSTER_SIZE) {
-        int32_t storedLink;
-        dataFileR.seekg(offset, std::ios_base::beg);
-        dataFileR.read((char*)&storedLink, sizeof(int32_t));
-        if (storedLink == fs::EMPTY_LINK) {
-            return indexInCluster;
+        auto& leaf = treeClusters.emplace_back();
+        leaf.fill(0);
+        std::size_t count = std::min(extents.size() - extent, fs::Inode::EXTENTS_IN_BLOCK);
+        fs::encodeInt32(leaf.data(), 0);
+        fs::encodeInt32(leaf.data() + sizeof(int32_t), count);
+        for (std::size_t entry = 0; entry < count; ++entry, ++extent) {
+            encodeExtentEntry(leaf.data(), entry, extents[extent].start, extents[extent].length);
+            firstCluster += extents[extent].length;
         }
+        writes.push_back({ m_device->clusterAddress(treeBlocks[block]), leaf.data(), leaf.size() });
+        claimCluster(treeBlocks[block]);
+    }
+}
 
-        indexInCluster += sizeof(fs::DirectoryItem);
-        offset += sizeof(fs::DirectoryItem);
+std::vector<fs::Extent> pfs::DataService::readExtentTree(const int32_t rootLink, std::vector<int32_t> &treeBlocks) const {
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> root {};
+    m_device->readCluster(rootLink, root.data());
+    treeBlocks.push_back(rootLink);
+
+    std::vector<fs::Extent> extents;
+    if (fs::decodeInt32(root.data()) == 0) {
+        decodeExtentLeaf(root.data(), extents);
+        return extents;
+    }
+
+    /// Reading all the leaves as one batch
+    std::size_t leafCount = std::min<std::size_t>(std::max(fs::decodeInt32(root.data() + sizeof(int32_t)), 0),
+                                                  fs::Inode::EXTENTS_IN_BLOCK);
+    std::vector<u_char> leaves(leafCount * fs::Superblock::CLUSTER_SIZE);
+    std::vector<pfs::ReadRequest> requests;
+    for (std::size_t entry = 0; entry < leafCount; ++entry) {
+        const u_char* record = root.data() + EXTENT_BLOCK_HEADER_SIZE + (entry * sizeof(fs::Extent));
+        int32_t leafLink = fs::decodeInt32(record + sizeof(int32_t));
+        treeBlocks.push_back(leafLink);
+        requests.push_back({ m_device->clusterAddress(leafLink), leaves.data() + (entry * fs::Superblock::CLUSTER_SIZE),
+                             fs::Superblock::CLUSTER_SIZE });
     }
+    m_device->readBatch(requests);
 
-    return indexInCluster;
+    for (std::size_t entry = 0; entry < leafCount; ++entry) {
+        decodeExtentLeaf(leaves.data() + (entry * fs::Superblock::CLUSTER_SIZE), extents);
+    }
+    return extents;
 }
 
-void pfs::DataService::saveDirItemToIndirect(const fs::DirectoryItem& directoryItem, fs::Inode& directory) {
-    int32_t lastFilledIndirectLink = directory.getLastFilledIndirectLinkValue();
-    if (lastFilledIndirectLink == fs::EMPTY_LINK) {
-        /// Every indirect link is free, we store directly and save index to indirect
-        saveDirItemToFreeIndirectLink(directoryItem, directory);
+void pfs::DataService::flush() {
+    if (!m_device) {
         return;
     }
 
-    /// First we need to check if there is any free space in the last filled indirect link
-    size_t indexInCluster = getFreeIndirectLinkDataBlockSubindex(lastFilledIndirectLink);
-    if (indexInCluster < fs::Superblock::CLUSTER_SIZE) {
-        /// We found free space in indirect link, now we check if the previous direct link is filled
-        /// If previous direct link is full, we store to new direct link, otherwise we store into
-        /// the previous link
-        size_t lastDirectLinkInIndirectLink;
-        {
-            std::ifstream dataFile(m_dataFileName, std::ios::out | std::ios::binary | std::ios::app);
-            if (!dataFile) {
-                throw std::ios_base::failure("Chyba při otevírání datového souboru!");
-            }
-            dataFile.seekg(m_dataStartAddress + (lastFilledIndirectLink * fs::Superblock::CLUSTER_SIZE) +
-                    (indexInCluster - sizeof(int32_t)), std::ios_base::beg);
-            dataFile.read((char *) &lastDirectLinkInIndirectLink, sizeof(lastDirectLinkInIndirectLink));
-        }
+    if (m_dataBitmap.isDirty()) {
+        m_dataBitmap.save(*m_device, m_dataBitmapAddress);
+    }
+    if (m_initializedClusterCountDirty) {
+        std::array<u_char, sizeof(int64_t)> count {};
+        fs::encodeInt64(count.data(), m_initializedClusterCount);
+        m_device->write(m_initializedClusterCountAddress, count.data(), count.size());
+        m_initializedClusterCountDirty = false;
+    }
+}
 
-        size_t indexInDirectLink = getFreeDirItemDataBlockSubindex(lastDirectLinkInIndirectLink);
-        if (indexInDirectLink < fs::Superblock::CLUSTER_SIZE) {
-            /// We found free space in direct link and save there
-            saveDirItemToAddress(directoryItem, m_dataStartAddress + (lastFilledIndirectLink * fs::Superblock::CLUSTER_SIZE) + indexInCluster);
-        } else {
-            int32_t addressToStoreTo = getFreeDataBlock();
-            saveDirItemToIndex(directoryItem, addressToStoreTo);
+bool pfs::DataService::claimCluster(const int32_t index) {
+    if (index < m_initializedClusterCount) {
+        return true;
+    }
 
-            std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-            if (!dataFile) {
-                throw std::ios_base::failure("Chyba při otevírání datového souboru!");
-            }
+    m_initializedClusterCount = index + 1;
+    m_initializedClusterCountDirty = true;
+    return false;
+}
 
-            dataFile.seekp(m_dataStartAddress + (lastFilledIndirectLink * fs::Superblock::CLUSTER_SIZE) + indexInCluster, std::ios_base::beg);
-            dataFile.write((char*)&addressToStoreTo, sizeof(addressToStoreTo));
-            dataFile.flush();
-        }
-    } else {
-        /// Last filled indirect link is full, we save into next indirect link
-        if (directory.getFirstFreeIndirectLink() == directory.getIndirectLinks().size()) {
-            /// Every direct and indirect link of current directory is filled, cannot save any more items
-            throw pfs::ObjectNotFound("Do předaného adresáře nelze uložit další soubory!");
-        }
+void pfs::DataService::addDataClusterWrites(std::vector<pfs::WriteRequest> &writes, const int32_t index,
+                                            const std::string &data) {
+    static const std::array<char, fs::Superblock::CLUSTER_SIZE> zeros { 0 };
 
-        saveDirItemToFreeIndirectLink(directoryItem, directory);
+    std::size_t address = m_device->clusterAddress(index);
+    writes.push_back({ address, data.data(), data.length() });
+    if (claimCluster(index) && data.length() < fs::Superblock::CLUSTER_SIZE) {
+        /// Rest of the last cluster may still hold data of a removed file
+        writes.push_back({ address + data.length(), zeros.data(), fs::Superblock::CLUSTER_SIZE - data.length() });
     }
 }
 
-void pfs::DataService::saveDirItemToFreeIndirectLink(const fs::DirectoryItem &directoryItem, fs::Inode& directory) {
-    int32_t addressToStoreTo = getFreeDataBlock();
-    saveDirItemToIndex(directoryItem, addressToStoreTo);
+void pfs::DataService::initializeDirectory(fs::Inode &directory, const int32_t parentId) {
+    int32_t cluster = allocateDataBlock(directory);
+    claimCluster(cluster);
+
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> data {};
+    fs::DirectoryItem(".", directory.getInodeId(), fs::FileType::DIRECTORY).encode(data.data());
+    fs::DirectoryItem("..", parentId, fs::FileType::DIRECTORY).encode(data.data() + fs::DirectoryItem::DISK_SIZE);
+    fs::DirectoryHeader().encode(data.data());
+    m_device->writeCluster(cluster, data.data());
+    directory.setDirectLink(0, cluster);
+}
+
+void pfs::DataService::saveDirItemIntoDirectory(const fs::DirectoryItem &directoryItem, fs::Inode& directory) {
+    if (!directory.isDirectory()) {
+        throw std::invalid_argument("Předaný i-uzel musí být složka!");
+    }
 
-    int32_t newIndirectLink = getFreeDataBlock();
-    directory.addIndirectLink(newIndirectLink);
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru!");
+    fs::DirectoryHeader header = readDirectoryHeader(directory);
+    if (header.getBucketCount() == 0) {
+        createFirstBucket(directory, header);
     }
 
-    dataFile.seekp(m_dataStartAddress + (newIndirectLink * fs::Superblock::CLUSTER_SIZE), std::ios_base::beg);
-    dataFile.write((char*)&addressToStoreTo, sizeof(addressToStoreTo));
-    /// Setting all other memory bits to -1 (empty) for future i/o operations
-    for (int i = sizeof(addressToStoreTo); i < fs::Superblock::CLUSTER_SIZE; ++i) {
-        dataFile.put(fs::EMPTY_LINK);
+    uint32_t hash = directoryItem.getNameHash();
+    while (true) {
+        int32_t cluster = findBucket(header, hash);
+        /// Free slot is taken from the bitmap of the bucket, so the bucket itself is read only when it's split
+        SlotBitmap& usedSlots = getBucketSlots(cluster);
+        if (!usedSlots.all()) {
+            std::size_t slot = 0;
+            while (usedSlots[slot]) {
+                ++slot;
+            }
+            directoryItem.save(*m_device, m_device->clusterAddress(cluster) + fs::DirectoryBucket::getSlotOffset(slot));
+            usedSlots[slot] = true;
+            break;
+        }
+
+        /// Bucket is full, it's items are split by one more bit of their hashes until the item's bucket has a free slot
+        splitBucket(directory, header, cluster, readBucket(cluster));
     }
-    dataFile.flush();
+
+    header.setItemCount(header.getItemCount() + 1);
+    writeDirectoryHeader(directory, header);
 }
 
-void pfs::DataService::clearInodeData(const fs::Inode &inode) {
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru!");
+pfs::DataService::SlotBitmap &pfs::DataService::getBucketSlots(const int32_t cluster) {
+    auto it = m_bucketSlots.find(cluster);
+    if (it != m_bucketSlots.end()) {
+        return it->second;
     }
 
-    std::array<int, fs::Superblock::CLUSTER_SIZE> buffer { 0 };
-    for (const auto &directLink : getAllDirectLinks(inode)) {
-        m_dataBitmap.setIndexFree(directLink);
-        dataFile.seekp(m_dataStartAddress + (directLink * fs::Superblock::CLUSTER_SIZE));
-        dataFile.write((char*)buffer.data(), buffer.size());
-        dataFile.flush();
+    return m_bucketSlots[cluster] = readBucket(cluster).getUsedSlots();
+}
+
+std::size_t pfs::DataService::getGroup(const fs::Inode &inode) const {
+    auto inodeGroup = static_cast<std::size_t>(inode.getInodeId() / m_inodesPerGroup);
+    return inodeGroup * m_groupCount / m_inodeGroupCount;
+}
+
+std::vector<int32_t> pfs::DataService::reserveClusters(const fs::Inode &owner, const std::size_t count) {
+    std::vector<int32_t> clusters;
+    if (count == 0) {
+        return clusters;
     }
 
-    for (const auto &indirectLink : inode.getIndirectLinks()) {
-        m_dataBitmap.setIndexFree(indirectLink);
-        dataFile.seekp(m_dataStartAddress + (indirectLink * fs::Superblock::CLUSTER_SIZE));
-        dataFile.write((char*) buffer.data(), buffer.size());
-        dataFile.flush();
+    for (const auto &[start, length] : m_dataBitmap.allocateRuns(count, getGroup(owner))) {
+        for (std::size_t i = 0; i < length; ++i) {
+            clusters.push_back(start + i);
+        }
     }
+    return clusters;
+}
 
-    m_dataBitmap.save(dataFile, m_dataBitmapAddress);
+void pfs::DataService::initializeLinkBlock(const int32_t block) {
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> links {};
+    encodeEmptyLinks(links.data());
+    claimCluster(block);
+    m_device->writeCluster(block, links.data());
 }
 
-fs::DirectoryItem pfs::DataService::removeDirectoryItem(const std::string &filename, fs::Inode& directory) {
-    fs::DirectoryItem dirItem;
+std::size_t pfs::DataService::getMissingLinkBlockCount(const fs::Inode &directory, const std::size_t position) const {
+    if (position < fs::Inode::DIRECT_LINKS_COUNT) {
+        return 0;
+    }
 
-    for (const auto &index : directory.getDirectLinks()) {
-        if (index == fs::EMPTY_LINK) {
-            continue;
+    std::size_t index = position - fs::Inode::DIRECT_LINKS_COUNT;
+    for (std::size_t tree = 0; tree < fs::DataLinks::TREE_DEPTHS.size(); ++tree) {
+        std::size_t depth = fs::DataLinks::TREE_DEPTHS[tree];
+        std::size_t capacity = 1;
+        for (std::size_t level = 0; level < depth; ++level) {
+            capacity *= fs::Inode::LINKS_IN_INDIRECT;
         }
-        try {
-            dirItem = removeDirItemFromCluster(filename, index);
-        } catch (const pfs::ObjectNotFound &ex) {
-            /// We didn't find directory item in this index, we continue to the next one
+        if (index >= capacity) {
+            index -= capacity;
             continue;
         }
 
-        if (isDirItemIndexFree(index)) {
-            m_dataBitmap.setIndexFree(index);
-            directory.clearDirectLink(index);
+        /// Every level from the first empty link down needs a new block
+        int32_t block = directory.getTreeLink(tree);
+        for (; depth > 0 && block != fs::EMPTY_LINK; --depth) {
+            if (depth == 1) {
+                return 0;
+            }
+            capacity /= fs::Inode::LINKS_IN_INDIRECT;
+            std::size_t entry = index / capacity;
+            index %= capacity;
+            block = readLink(block, entry);
         }
-
-        return dirItem;
+        return depth;
     }
 
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevírání datového souboru!");
+    throw pfs::ObjectNotFound("Do předaného adresáře nelze uložit další soubory!");
+}
+
+void pfs::DataService::addDirectoryBlock(fs::Inode &directory, const std::size_t position, const int32_t cluster,
+                                         std::vector<int32_t> &linkBlocks) {
+    auto takeLinkBlock = [&]() {
+        int32_t block = linkBlocks.back();
+        linkBlocks.pop_back();
+        initializeLinkBlock(block);
+        return block;
+    };
+
+    if (position < fs::Inode::DIRECT_LINKS_COUNT) {
+        directory.setDirectLink(position, cluster);
+        return;
     }
 
-    int32_t directLink = fs::EMPTY_LINK;
-    for (const auto &index : directory.getIndirectLinks()) {
-        if (index == fs::EMPTY_LINK) {
+    /// Position is counted from the first block linked by the trees, then from the first block of the right tree
+    std::size_t index = position - fs::Inode::DIRECT_LINKS_COUNT;
+    for (std::size_t tree = 0; tree < fs::DataLinks::TREE_DEPTHS.size(); ++tree) {
+        std::size_t depth = fs::DataLinks::TREE_DEPTHS[tree];
+        std::size_t capacity = 1;
+        for (std::size_t level = 0; level < depth; ++level) {
+            capacity *= fs::Inode::LINKS_IN_INDIRECT;
+        }
+        if (index >= capacity) {
+            index -= capacity;
             continue;
         }
 
-        for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(int32_t)) {
-            dataFile.seekg(m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE) + i, std::ios::beg);
-            dataFile.read((char*)&directLink, sizeof(int32_t));
-            if (directLink == fs::EMPTY_LINK) {
-                continue;
+        int32_t block = directory.getTreeLink(tree);
+        if (block == fs::EMPTY_LINK) {
+            block = takeLinkBlock();
+            directory.setTreeLink(tree, block);
+        }
+        std::array<u_char, fs::Superblock::CLUSTER_SIZE> links {};
+        for (; depth > 0; --depth) {
+            capacity /= fs::Inode::LINKS_IN_INDIRECT;
+            std::size_t entry = index / capacity;
+            index %= capacity;
+            m_device->readCluster(block, links.data());
+            if (depth == 1) {
+                encodeLink(links.data(), entry, cluster);
+                m_device->writeCluster(block, links.data());
+                return;
             }
-
-            try {
-                dirItem = removeDirItemFromCluster(filename, directLink);
-            } catch (const pfs::ObjectNotFound& ex) {
-                /// We didn't find directory item in this index, we continue to the next one
-                continue;
+            if (decodeLink(links.data(), entry) == fs::EMPTY_LINK) {
+                encodeLink(links.data(), entry, takeLinkBlock());
+                m_device->writeCluster(block, links.data());
             }
+            block = decodeLink(links.data(), entry);
+        }
+    }
 
-            if (isDirItemIndexFree(directLink)) {
-                m_dataBitmap.setIndexFree(directLink);
+    throw pfs::ObjectNotFound("Do předaného adresáře nelze uložit další soubory!");
+}
 
-                if (isIndirectLinkFree(index)) {
-                    m_dataBitmap.setIndexFree(index);
-                    directory.clearIndirectLink(index);
-                }
-            }
+int32_t pfs::DataService::readLink(const int32_t block, const std::size_t entry) const {
+    std::array<u_char, sizeof(int32_t)> link {};
+    m_device->read(m_device->clusterAddress(block) + (entry * sizeof(int32_t)), link.data(), link.size());
+    return fs::decodeInt32(link.data());
+}
+
+int32_t pfs::DataService::getDirectoryBlock(const fs::Inode &directory, const std::size_t position) const {
+    if (position < fs::Inode::DIRECT_LINKS_COUNT) {
+        return directory.getDirectLinks()[position];
+    }
+
+    std::size_t index = position - fs::Inode::DIRECT_LINKS_COUNT;
+    for (std::size_t tree = 0; tree < fs::DataLinks::TREE_DEPTHS.size(); ++tree) {
+        std::size_t depth = fs::DataLinks::TREE_DEPTHS[tree];
+        std::size_t capacity = 1;
+        for (std::size_t level = 0; level < depth; ++level) {
+            capacity *= fs::Inode::LINKS_IN_INDIRECT;
+        }
+        if (index >= capacity) {
+            index -= capacity;
+            continue;
+        }
 
-            return dirItem;
+        /// Only the one link on every level of the tree is read
+        int32_t block = directory.getTreeLink(tree);
+        for (; depth > 0 && block != fs::EMPTY_LINK; --depth) {
+            capacity /= fs::Inode::LINKS_IN_INDIRECT;
+            std::size_t entry = index / capacity;
+            index %= capacity;
+            block = readLink(block, entry);
         }
+        return block;
     }
 
-    throw pfs::ObjectNotFound("DirectoryItem s názvem " + filename + " nenalezen");
+    return fs::EMPTY_LINK;
 }
 
-bool pfs::DataService::isDirItemIndexFree(const int32_t index) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevírání datového souboru!");
-    }
+fs::DirectoryHeader pfs::DataService::readDirectoryHeader(const fs::Inode &directory) const {
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> data {};
+    m_device->readCluster(directory.getDirectLinks()[0], data.data());
+    fs::DirectoryHeader header;
+    header.decode(data.data());
+    return header;
+}
 
-    fs::DirectoryItem dirItem;
-    dirItem.load(dataFile, m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE));
-    return ((dirItem.getInodeId() == 0) && (dirItem.getItemName()[0] == 0));
+void pfs::DataService::writeDirectoryHeader(const fs::Inode &directory, const fs::DirectoryHeader &header) {
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> data {};
+    header.encode(data.data());
+    /// Only the header is written, the items "." and ".." in front of it are left as they are
+    std::size_t length = (3 + header.getTableLinks().size()) * sizeof(int32_t);
+    m_device->write(m_device->clusterAddress(directory.getDirectLinks()[0]) + fs::DirectoryHeader::OFFSET,
+                    data.data() + fs::DirectoryHeader::OFFSET, length);
+}
+
+int32_t pfs::DataService::findBucket(const fs::DirectoryHeader &header, const uint32_t hash) const {
+    std::size_t entry = header.getTableEntry(hash);
+    int32_t tableLink = header.getTableLinks().at(entry / fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER);
+    std::array<u_char, sizeof(int32_t)> bucket {};
+    m_device->read(m_device->clusterAddress(tableLink)
+                   + (entry % fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER) * sizeof(int32_t),
+                   bucket.data(), bucket.size());
+    return fs::decodeInt32(bucket.data());
 }
 
-bool pfs::DataService::isIndirectLinkFree(const int32_t index) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevírání datového souboru!");
+std::vector<int32_t> pfs::DataService::readBucketTable(const fs::DirectoryHeader &header) const {
+    const std::vector<int32_t>& tableLinks = header.getTableLinks();
+    std::vector<u_char> data(tableLinks.size() * fs::Superblock::CLUSTER_SIZE);
+    std::vector<pfs::ReadRequest> requests;
+    for (std::size_t i = 0; i < tableLinks.size(); ++i) {
+        requests.push_back({ m_device->clusterAddress(tableLinks[i]), data.data() + (i * fs::Superblock::CLUSTER_SIZE),
+                             fs::Superblock::CLUSTER_SIZE });
     }
+    m_device->readBatch(requests);
 
-    int32_t directLink;
-    dataFile.seekg(m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE));
-    dataFile.read((char*)&directLink, sizeof(directLink));
-    return directLink == 0;
+    std::vector<int32_t> table(header.getTableSize());
+    for (std::size_t entry = 0; entry < table.size(); ++entry) {
+        table[entry] = fs::decodeInt32(data.data() + (entry * sizeof(int32_t)));
+    }
+    return table;
 }
 
-fs::DirectoryItem pfs::DataService::removeDirItemFromCluster(const std::string &filename, const int index) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevírání datového souboru!");
-    }
+fs::DirectoryBucket pfs::DataService::readBucket(const int32_t cluster) const {
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> data {};
+    m_device->readCluster(cluster, data.data());
+    fs::DirectoryBucket bucket;
+    bucket.decode(data.data());
+    return bucket;
+}
 
-    fs::DirectoryItem dirItem;
-    for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(fs::DirectoryItem)) {
-        dirItem.load(dataFile, m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE) + i);
-        if (dirItem.nameEquals(filename)) {
-            std::fstream dataFileW(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-            if (!dataFileW) {
-                throw std::ios::failure("Chyba při otevírání datového souboru");
-            }
+void pfs::DataService::createFirstBucket(fs::Inode &directory, fs::DirectoryHeader &header) {
+    /// Both clusters are reserved at once, so a full disk leaves the directory unchanged
+    std::vector<int32_t> clusters(reserveClusters(directory, 2));
+    int32_t tableCluster = clusters.back();
+    clusters.pop_back();
+    int32_t bucketCluster = clusters.back();
+    clusters.pop_back();
+
+    std::array<u_char, fs::Superblock::CLUSTER_SIZE> data {};
+    fs::DirectoryBucket().encode(data.data());
+    claimCluster(bucketCluster);
+    m_device->writeCluster(bucketCluster, data.data());
+    /// Table of global depth 0 has the only entry
+    data.fill(0);
+    fs::encodeInt32(data.data(), bucketCluster);
+    claimCluster(tableCluster);
+    m_device->writeCluster(tableCluster, data.data());
+
+    addDirectoryBlock(directory, 1, bucketCluster, clusters);
+    m_bucketSlots[bucketCluster] = SlotBitmap();
+    header.setGlobalDepth(0);
+    header.setBucketCount(1);
+    header.setTableLinks({ tableCluster });
+}
 
-            dataFileW.seekp(m_dataStartAddress + (index * fs::Superblock::CLUSTER_SIZE) + i, std::ios::beg);
-            for (int j = 0; j < sizeof(fs::DirectoryItem); ++j) {
-                dataFileW.put('\0');
-            }
+void pfs::DataService::splitBucket(fs::Inode &directory, fs::DirectoryHeader &header, const int32_t cluster,
+                                   const fs::DirectoryBucket &bucket) {
+    int32_t depth = bucket.getLocalDepth();
+    std::vector<int32_t> table = readBucketTable(header);
+    std::vector<int32_t> tableLinks = header.getTableLinks();
+    /// Range of the changed clusters of the table, all of them if it's doubled
+    std::size_t firstChanged = tableLinks.size();
+    std::size_t lastChanged = 0;
+    bool doubled = depth >= header.getGlobalDepth();
+    std::size_t newTableClusters = 0;
+    if (doubled) {
+        if (header.getGlobalDepth() >= fs::DirectoryHeader::MAX_DEPTH) {
+            throw pfs::ObjectNotFound("Do předaného adresáře nelze uložit další soubory!");
+        }
+        std::size_t tableClusters = (2 * table.size() + fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER - 1)
+                / fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER;
+        newTableClusters = tableClusters - tableLinks.size();
+    }
+
+    /// Every cluster of the split is reserved at once before anything is changed, so a full disk leaves
+    /// the directory as it was - the new bucket, the new clusters of the table and the missing blocks of links
+    std::size_t position = header.getBucketCount() + 1;
+    std::vector<int32_t> clusters(reserveClusters(directory,
+                                                  1 + newTableClusters + getMissingLinkBlockCount(directory, position)));
+    int32_t newCluster = clusters.back();
+    clusters.pop_back();
+    claimCluster(newCluster);
+
+    if (doubled) {
+        /// The upper half of the doubled table selects the same buckets as the lower one
+        table.insert(table.end(), table.begin(), table.end());
+        header.setGlobalDepth(header.getGlobalDepth() + 1);
+        for (std::size_t i = 0; i < newTableClusters; ++i) {
+            int32_t tableCluster = clusters.back();
+            clusters.pop_back();
+            claimCluster(tableCluster);
+            tableLinks.push_back(tableCluster);
+        }
+        header.setTableLinks(tableLinks);
+        firstChanged = 0;
+        lastChanged = tableLinks.size() - 1;
+    }
+
+    /// The rest of the reserved clusters are the blocks of links
+    addDirectoryBlock(directory, position, newCluster, clusters);
+    header.setBucketCount(header.getBucketCount() + 1);
+
+    fs::DirectoryBucket lower;
+    fs::DirectoryBucket upper;
+    lower.setLocalDepth(depth + 1);
+    upper.setLocalDepth(depth + 1);
+    std::size_t lowerSlot = 0;
+    std::size_t upperSlot = 0;
+    for (const auto &item : bucket.getItems()) {
+        if (item.isFree()) {
+            continue;
+        }
+        if ((item.getNameHash() >> depth) & 1u) {
+            upper.setItem(upperSlot++, item);
+        } else {
+            lower.setItem(lowerSlot++, item);
+        }
+    }
 
-            return dirItem;
+    for (std::size_t entry = 0; entry < table.size(); ++entry) {
+        if (table[entry] == cluster && ((entry >> depth) & 1u)) {
+            table[entry] = newCluster;
+            firstChanged = std::min(firstChanged, entry / fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER);
+            lastChanged = std::max(lastChanged, entry / fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER);
         }
     }
 
-    throw pfs::ObjectNotFound("Directory item s názvem " + filename + " nenalezen");
+    /// Both buckets and the changed clusters of the table are written as one batch
+    std::vector<u_char> data((2 + lastChanged - firstChanged + 1) * fs::Superblock::CLUSTER_SIZE, 0);
+    std::vector<pfs::WriteRequest> writes;
+    lower.encode(data.data());
+    upper.encode(data.data() + fs::Superblock::CLUSTER_SIZE);
+    m_bucketSlots[cluster] = lower.getUsedSlots();
+    m_bucketSlots[newCluster] = upper.getUsedSlots();
+    writes.push_back({ m_device->clusterAddress(cluster), data.data(), fs::Superblock::CLUSTER_SIZE });
+    writes.push_back({ m_device->clusterAddress(newCluster), data.data() + fs::Superblock::CLUSTER_SIZE,
+                       fs::Superblock::CLUSTER_SIZE });
+    for (std::size_t tableCluster = firstChanged; tableCluster <= lastChanged; ++tableCluster) {
+        u_char* block = data.data() + (2 + tableCluster - firstChanged) * fs::Superblock::CLUSTER_SIZE;
+        std::size_t first = tableCluster * fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER;
+        for (std::size_t entry = first;
+             entry < std::min(table.size(), first + fs::DirectoryHeader::ENTRIES_IN_TABLE_CLUSTER); ++entry) {
+            fs::encodeInt32(block + (entry - first) * sizeof(int32_t), table[entry]);
+        }
+        writes.push_back({ m_device->clusterAddress(tableLinks[tableCluster]), block, fs::Superblock::CLUSTER_SIZE });
+    }
+    m_device->writeBatch(writes);
+    writeDirectoryHeader(directory, header);
 }
 
-fs::DirectoryItem pfs::DataService::findDirectoryItem(const std::filesystem::path &fileName, const fs::Inode& directory) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevírání datového souboru!");
+void pfs::DataService::clearInodeData(const fs::Inode &inode) {
+    if (inode.hasInlineData()) {
+        return;
+    }
+    if (inode.isDirectory()) {
+        /// Bucket table is linked from the index header only, the rest of the directory clusters by the i-node
+        for (const auto &tableLink : readDirectoryHeader(inode).getTableLinks()) {
+            m_dataBitmap.setIndexFree(tableLink);
+        }
     }
 
-    fs::DirectoryItem dirItem;
-    for (const auto &directLink : directory.getDirectLinks()) {
-        if (directLink == fs::EMPTY_LINK) {
-            throw pfs::ObjectNotFound("Directory item s předaným názvem nenalezen!");
+    /// Freed clusters are not zeroed, they are zeroed when they get allocated again
+    /// Blocks of extent tree or blocks of indirect links
+    std::vector<int32_t> treeBlocks;
+    std::vector<fs::Extent> extents;
+    if (!inode.usesExtents()) {
+        for (const auto &directLink : readLinkTrees(inode, treeBlocks)) {
+            m_dataBitmap.setIndexFree(directLink);
+            /// Slots of a freed bucket are forgotten, the cluster may become a bucket of another directory
+            m_bucketSlots.erase(directLink);
         }
+    } else if (inode.getExtentTreeLink() != fs::EMPTY_LINK) {
+        extents = readExtentTree(inode.getExtentTreeLink(), treeBlocks);
+    } else {
+        extents = getDataExtents(inode);
+    }
 
-        for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(fs::DirectoryItem)) {
-            dirItem.load(dataFile,m_dataStartAddress + (directLink * fs::Superblock::CLUSTER_SIZE) + i);
-            if (dirItem.nameEquals(fileName)) {
-                return dirItem;
-            }
+    for (const auto &extent : extents) {
+        for (int32_t i = 0; i < extent.length; ++i) {
+            m_dataBitmap.setIndexFree(extent.start + i);
         }
     }
 
-    int32_t directLink = fs::EMPTY_LINK;
-    for (const auto &indirectLink : directory.getIndirectLinks()) {
-        if (indirectLink == fs::EMPTY_LINK) {
-            throw pfs::ObjectNotFound("Directory item s předaným názvem nenalezen!");
+    for (const auto &treeBlock : treeBlocks) {
+        m_dataBitmap.setIndexFree(treeBlock);
+    }
+}
+
+fs::DirectoryItem pfs::DataService::removeDirectoryItem(const std::string &filename, fs::Inode& directory) {
+    fs::DirectoryHeader header = readDirectoryHeader(directory);
+    if (header.getBucketCount() > 0) {
+        int32_t cluster = findBucket(header, fs::hashName(filename));
+        fs::DirectoryBucket bucket = readBucket(cluster);
+        std::size_t slot = bucket.findItem(filename);
+        if (slot < fs::DirectoryBucket::ITEM_COUNT) {
+            /// Buckets are never merged, the slot is just freed for the next item with the same hash bits
+            m_device->zero(m_device->clusterAddress(cluster) + fs::DirectoryBucket::getSlotOffset(slot),
+                           fs::DirectoryItem::DISK_SIZE);
+            /// The bucket is read anyway, so it's bitmap is refreshed with the hole
+            SlotBitmap usedSlots = bucket.getUsedSlots();
+            usedSlots[slot] = false;
+            m_bucketSlots[cluster] = usedSlots;
+            header.setItemCount(header.getItemCount() - 1);
+            writeDirectoryHeader(directory, header);
+            return bucket.getItems()[slot];
         }
+    }
 
-        for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(int32_t)) {
-            dataFile.seekg(m_dataStartAddress + (indirectLink * fs::Superblock::CLUSTER_SIZE) + i, std::ios::beg);
-            dataFile.read((char*)&directLink, sizeof(directLink));
-            if (directLink == fs::EMPTY_LINK) {
-                continue;
-            }
-            for (int j = 0; j < fs::Superblock::CLUSTER_SIZE; j += sizeof(fs::DirectoryItem)) {
-                dirItem.load(dataFile,m_dataStartAddress + (directLink * fs::Superblock::CLUSTER_SIZE) + j);
-                if (dirItem.nameEquals(fileName)) {
-                    return dirItem;
-                }
-            }
+    throw pfs::ObjectNotFound("DirectoryItem s názvem " + filename + " nenalezen");
+}
+
+fs::DirectoryItem pfs::DataService::findDirectoryItem(const std::filesystem::path &fileName, const fs::Inode& directory) const {
+    const std::string name = fileName.string();
+    fs::DirectoryItem dirItem;
+    if (name == "." || name == "..") {
+        /// Items "." and ".." are stored in front of the index
+        dirItem.load(*m_device, m_device->clusterAddress(directory.getDirectLinks()[0])
+                                + (name == "." ? 0 : fs::DirectoryItem::DISK_SIZE));
+        return dirItem;
+    }
+
+    fs::DirectoryHeader header = readDirectoryHeader(directory);
+    if (header.getBucketCount() > 0) {
+        fs::DirectoryBucket bucket = readBucket(findBucket(header, fs::hashName(name)));
+        std::size_t slot = bucket.findItem(name);
+        if (slot < fs::DirectoryBucket::ITEM_COUNT) {
+            return bucket.getItems()[slot];
         }
     }
 
     throw pfs::ObjectNotFound("Directory item s předaným názvem nenalezen!");
 }
 
+int32_t pfs::DataService::getDirectoryItemCount(const fs::Inode &directory) const {
+    return readDirectoryHeader(directory).getItemCount();
+}
+
 std::string pfs::DataService::getFileContent(const fs::Inode &inode) const {
     if (inode.isDirectory()) {
         throw std::invalid_argument("Obsah složky nelze vypsat! Použijte funkci \"ls\"!");
     }
 
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevírání datového souboru!");
+    if (inode.hasInlineData()) {
+        /// The data were read with the i-node
+        return inode.getInlineData();
     }
 
-    std::string fileContent;
-    std::array<char, fs::Superblock::CLUSTER_SIZE> buffer { 0 };
-    for (const auto &directLink : inode.getDirectLinks()) {
-        if (directLink == fs::EMPTY_LINK) {
-            return fileContent;
-        }
-        dataFile.seekg(m_dataStartAddress + (directLink * fs::Superblock::CLUSTER_SIZE), std::ios::beg);
-        dataFile.read(buffer.data(), buffer.size());
-        for (const auto& c : buffer) {
-            if (fileContent.size() == inode.getFileSize()) {
-                return fileContent;
-            }
-            fileContent += c;
-        }
+    std::vector<fs::Extent> extents = getDataExtents(inode);
+    std::size_t clusterCount = 0;
+    for (const auto &extent : extents) {
+        clusterCount += extent.length;
     }
+    std::size_t contentSize = std::min<std::size_t>(std::max<int64_t>(inode.getFileSize(), 0),
+                                                    clusterCount * fs::Superblock::CLUSTER_SIZE);
+    std::string fileContent(contentSize, '\0');
 
-    int32_t directLink = fs::EMPTY_LINK;
-    for (const auto &indirectLink : inode.getIndirectLinks()) {
-        if (indirectLink == fs::EMPTY_LINK) {
-            return fileContent;
-        }
-        for (int i = 0; i < fs::Superblock::CLUSTER_SIZE; i += sizeof(int32_t)) {
-            dataFile.seekg(m_dataStartAddress + (indirectLink * fs::Superblock::CLUSTER_SIZE) + i, std::ios::beg);
-            dataFile.read((char *) &directLink, sizeof(directLink));
-            if (directLink == fs::EMPTY_LINK) {
-                return fileContent;
-            }
-            dataFile.seekg(m_dataStartAddress + (directLink * fs::Superblock::CLUSTER_SIZE), std::ios::beg);
-            dataFile.read(buffer.data(), buffer.size());
-            for (const auto& c : buffer) {
-                if (fileContent.size() == inode.getFileSize()) {
-                    return fileContent;
-                }
-                fileContent += c;
-            }
-        }
-
+    /// Reading every extent of the file as one request, all in one batch, so the device may have them in flight at once
+    std::vector<pfs::ReadRequest> requests;
+    std::size_t offset = 0;
+    for (auto extent = extents.begin(); extent != extents.end() && offset < contentSize; ++extent) {
+        std::size_t length = std::min(contentSize - offset, extent->length * fs::Superblock::CLUSTER_SIZE);
+        requests.push_back({ m_device->clusterAddress(extent->start), fileContent.data() + offset, length });
+        offset += length;
     }
+    m_device->readBatch(requests);
 
     return fileContent;
 }
@@ -7,32 +7,63 @@
 
 #include <string>
 #include <vector>
+#include <list>
 #include <filesystem>
+#include <memory>
+#include <bitset>
+#include <unordered_map>
+#include <functional>
+#include <istream>
 #include "../common/structures.h"
 #include "FileData.h"
+#include "BlockDevice.h"
+#include "GroupedBitmap.h"
 
 namespace pfs {
 
     /**
-     * Class responsible for manipulation with inode data.
+     * Class responsible for manipulation with inode data. Directories are stored as hashed indexes of their items,
+     * see @a fs::DirectoryHeader, so an item is found, saved or removed by reading a constant number of clusters.
      */
     class DataService {
     private: // private attributes
-        /// Data file representing the virtual file system
-        std::string m_dataFileName;
-        /// Data block bitmap
-        fs::Bitmap m_dataBitmap;
+        /// Number of clusters read from a stream and written at once when a file is saved from a stream
+        static constexpr std::size_t STREAM_BUFFER_CLUSTERS = 16;
+        /// Bitmap of used slots of a bucket
+        using SlotBitmap = std::bitset<fs::DirectoryBucket::ITEM_COUNT>;
+
+        /// Device representing the data file of the virtual file system
+        std::shared_ptr<pfs::BlockDevice> m_device;
+        /// Data block bitmap, split into allocation groups
+        pfs::GroupedBitmap m_dataBitmap;
         /// Address where to store the data bitmap
-        int32_t m_dataBitmapAddress = -1;
-        /// Start address of the data block storage
-        int32_t m_dataStartAddress = -1;
+        std::size_t m_dataBitmapAddress = 0;
+        /// Number of i-nodes in one allocation group, blocks of a file are allocated in the group of it's i-node
+        int32_t m_inodesPerGroup = 1;
+        /// Number of allocation groups of the data bitmap
+        int32_t m_groupCount = 1;
+        /// Number of allocation groups of the i-node bitmap, i-node groups are mapped onto the data groups proportionally
+        int32_t m_inodeGroupCount = 1;
+        /// Number of clusters written since format, clusters behind them are still zero
+        int64_t m_initializedClusterCount = 0;
+        /// Address where to store the number of initialized clusters
+        std::size_t m_initializedClusterCountAddress = 0;
+        /// Was the number of initialized clusters changed since the last flush?
+        bool m_initializedClusterCountDirty = false;
+        /**
+         * Used slots of the directory buckets by their clusters. Bitmaps are filled lazily, when a bucket is first
+         * inserted into since the mount, because building them at mount would read every bucket of every directory.
+         * They only spare reading the bucket, the header and one table entry are still read by every insert.
+         */
+        std::unordered_map<int32_t, SlotBitmap> m_bucketSlots;
 
     public: // public methods
         DataService() = default;
-        DataService(std::string mDataFileName, fs::Bitmap dataBitmap,
-                    int32_t dataBitmapAddress, int32_t dataStartAddress);
+        DataService(std::shared_ptr<pfs::BlockDevice> device, const fs::Superblock& superblock,
+                    pfs::GroupedBitmap dataBitmap);
         /**
          * Returns all directory items of directory, represented by given inode. If inode doesn't represent folder, throws @a invalid_argument
+         * All the clusters of the directory are read at once, @a DirectoryCursor lists the directory cluster by cluster.
          *
          * @param directory inode representing the directory
          * @return vector of directory items
@@ -40,20 +71,73 @@ namespace pfs {
          */
         [[nodiscard]] std::vector<fs::DirectoryItem> getDirectoryItems(const fs::Inode& directory) const;
         /**
-         * Returns index of free data block. If none is found, throws ObjectNotFound.
+         * Returns the number of clusters holding the items of given directory - the first cluster with "." and ".."
+         * and all the buckets.
+         *
+         * @param directory inode representing the directory
+         * @return number of clusters with directory items
+         * @throw invalid_argument if the inode doesn't represent a directory
+         */
+        [[nodiscard]] std::size_t getDirectoryBlockCount(const fs::Inode& directory) const;
+        /**
+         * Reads the items stored in the cluster on given position of given directory. The first cluster holds
+         * the items "." and ".." in it's first two slots, the other ones are buckets.
+         *
+         * @param directory inode representing the directory
+         * @param position position of the cluster in the directory data, lower than @a getDirectoryBlockCount
+         * @return items of the cluster, free slots included
+         */
+        [[nodiscard]] fs::DirectoryBucket readDirectoryBlock(const fs::Inode& directory, std::size_t position) const;
+        /**
+         * Allocates a free data block in the allocation group of given i-node, or in the following groups if it's full.
+         *
+         * @param owner i-node the block is allocated for
+         * @return index of the allocated data block
          * @throw ObjectNotFound if no free index is found
-         * @return free index of data block
          */
-        [[nodiscard]] int32_t getFreeDataBlock() const;
+        int32_t allocateDataBlock(const fs::Inode& owner);
         /**
-         * Returns indexes of free data blocks based on the requested count. If none or less than requested count
-         * is found, throws ObjectNotFound.
+         * Allocates data blocks based on the requested count and returns their indexes, ordered the way they are linked
+         * from the inode of a file. If none or less than requested count is found, throws ObjectNotFound.
          *
-         * @param count requested number of free data blocks
-         * @return vector of free data block indexes
+         * Blocks are taken from the smallest run of consecutive free blocks the whole file fits into, looking into
+         * the allocation group of the file's i-node first. If there is no such run, the file is split into as few
+         * fragments as possible, always taking the largest run until the rest fits into one. Blocks of indirect links
+         * are taken from the end of the allocation, so the data of the file stay consecutive.
+         *
+         * @param count requested number of data blocks
+         * @param owner i-node the blocks are allocated for
+         * @return vector of allocated data block indexes
          * @throw ObjectNotFound when no free index is found or not enough free indexes are found
          */
-        [[nodiscard]] std::vector<int32_t> getFreeDataBlocks(std::size_t count) const;
+        std::vector<int32_t> allocateDataBlocks(std::size_t count, const fs::Inode& owner);
+        /**
+         * Returns the allocation group with the most free data blocks, where new directories should be placed.
+         *
+         * @return index of the allocation group
+         */
+        [[nodiscard]] std::size_t findEmptiestGroup() const;
+        /**
+         * Allocates data blocks for a file of given number of clusters, mapped by extents. Clusters are taken the same
+         * way as by @a allocateDataBlocks, each consecutive run being one extent. If there are more extents than fit
+         * into the i-node, blocks of the extent tree are allocated as well.
+         *
+         * @param clusterCount number of data clusters of the file
+         * @param owner i-node the blocks are allocated for
+         * @param treeBlocks output for allocated blocks of the extent tree, root first, empty if the extents fit into the i-node
+         * @return extents of the allocated clusters in the order of the file data
+         * @throw ObjectNotFound when not enough free indexes are found
+         */
+        std::vector<fs::Extent> allocateExtents(std::size_t clusterCount, const fs::Inode& owner,
+                                                std::vector<int32_t>& treeBlocks);
+        /**
+         * Returns the extents of given file's data in the order of the data. Files mapped by links get one extent
+         * for every run of consecutive links, files with inline data get none.
+         *
+         * @param inode inode to return it's extents
+         * @return extents of the file's data
+         */
+        [[nodiscard]] std::vector<fs::Extent> getDataExtents(const fs::Inode &inode) const;
         /**
          * Returns all direct links to a file data, including the ones stored in indirect links.
          *
@@ -62,11 +146,30 @@ namespace pfs {
          */
         [[nodiscard]] std::vector<int32_t> getAllDirectLinks(const fs::Inode &inode) const;
         /**
-         * Saves given directory item into given directory.
+         * Returns the number of fragments of given file's data, a fragment being a run of data blocks
+         * stored one after another.
+         *
+         * @param inode inode to return it's fragment count
+         * @return number of fragments, zero for a file without data
+         */
+        [[nodiscard]] std::size_t getFragmentCount(const fs::Inode &inode) const;
+        /**
+         * Allocates the first cluster of given new directory and stores the items "." and ".." and an empty index
+         * into it.
+         *
+         * @param directory i-node of the new directory, gets linked to the cluster
+         * @param parentId i-node ID of the parent directory
+         * @throw ObjectNotFound if there is no free cluster
+         */
+        void initializeDirectory(fs::Inode& directory, int32_t parentId);
+        /**
+         * Saves given directory item into given directory. The bucket selected by the item's name hash is split
+         * if it's full, so the directory may get new clusters and the caller has to save it's i-node.
          *
          * @param directoryItem directory item to save
          * @param directory directory to save given directory item into
          * @throw invalid_argument if given inode is not a directory
+         * @throw ObjectNotFound if the directory can't hold any more items
          */
         void saveDirItemIntoDirectory(const fs::DirectoryItem &directoryItem, fs::Inode& directory);
         /**
@@ -91,13 +194,54 @@ namespace pfs {
          * @throw ObjectNotFound if the directory doesn't contain a directory item with given name
          */
         [[nodiscard]] fs::DirectoryItem findDirectoryItem(const std::filesystem::path &fileName, const fs::Inode& directory) const;
+        /**
+         * Returns the number of items of given directory, not counting "." and "..".
+         *
+         * @param directory directory to count items of
+         * @return number of directory items
+         */
+        [[nodiscard]] int32_t getDirectoryItemCount(const fs::Inode& directory) const;
         /**
          * Saves all file data into the file system data file.
          *
          * @param clusteredData file data parsed into clusters
-         * @param dataClusterIndexes indexes of clusters in the file system data file
+         * @param dataClusterIndexes indexes of clusters in the file system data file, allocated by @a allocateDataBlocks
          */
         void saveFileData(const fs::ClusteredFileData& clusteredData, const std::vector<int32_t>& dataClusterIndexes);
+        /**
+         * Saves all file data into given extents, writes the extent tree if needed and maps given inode by the extents.
+         *
+         * @param clusteredData file data parsed into clusters
+         * @param extents extents of the file data, allocated by @a allocateExtents
+         * @param treeBlocks blocks of the extent tree, allocated by @a allocateExtents
+         * @param inode inode of the file
+         */
+        void saveFileData(const fs::ClusteredFileData& clusteredData, const std::vector<fs::Extent>& extents,
+                          const std::vector<int32_t>& treeBlocks, fs::Inode& inode);
+        /**
+         * Saves file data read from given stream into given clusters, allocated by @a allocateDataBlocks. Blocks
+         * of links are written first, data then passes through one buffer of @a STREAM_BUFFER_CLUSTERS clusters,
+         * so the memory used doesn't grow with the size of the file.
+         *
+         * @param stream stream to read the data from
+         * @param size number of bytes to read from the stream
+         * @param dataClusterIndexes indexes of clusters in the file system data file, allocated by @a allocateDataBlocks
+         * @throw ios_base::failure if the stream ends before @a size bytes are read
+         */
+        void saveFileData(std::istream& stream, std::size_t size, const std::vector<int32_t>& dataClusterIndexes);
+        /**
+         * Saves file data read from given stream into given extents and maps given inode by them. The mapping is
+         * written first, data then passes through one buffer of @a STREAM_BUFFER_CLUSTERS clusters.
+         *
+         * @param stream stream to read the data from
+         * @param size number of bytes to read from the stream
+         * @param extents extents of the file data, allocated by @a allocateExtents
+         * @param treeBlocks blocks of the extent tree, allocated by @a allocateExtents
+         * @param inode inode of the file
+         * @throw ios_base::failure if the stream ends before @a size bytes are read
+         */
+        void saveFileData(std::istream& stream, std::size_t size, const std::vector<fs::Extent>& extents,
+                          const std::vector<int32_t>& treeBlocks, fs::Inode& inode);
         /**
          * Returns concatenated data of given file.
          *
@@ -107,34 +251,121 @@ namespace pfs {
          */
         [[nodiscard]] std::string getFileContent(const fs::Inode &inode) const;
         /**
-         * Checks given data block containing directory items for a free sub-index, where next directory item could be stored.
-         * If none is found, returns the size of a cluster.
-         *
-         * @param dirItemDataBlockSubindex index of a data block
-         * @return free sub-index in given data block or size of a data block
+         * Saves changed parts of the data bitmap and the number of initialized clusters. Changes made by the other
+         * methods are kept only in the memory until this method is called.
          */
-        [[nodiscard]] size_t getFreeDirItemDataBlockSubindex(int32_t dirItemDataBlockSubindex) const;
+        void flush();
     private: // private methods
-        /// Reads all directory items on given indexes
-        [[nodiscard]] std::vector<fs::DirectoryItem> readDirItems(const std::vector<int32_t> &indexList) const;
-        /// Saves directory item to any free direct link of given directory
-        bool saveDirItemToFreeDirectLink(const fs::DirectoryItem& directoryItem, fs::Inode& directory);
-        /// Saves directory item to given data block index
-        void saveDirItemToIndex(const fs::DirectoryItem &directoryItem, int32_t index);
-        /// Saves directory item to given address
-        void saveDirItemToAddress(const fs::DirectoryItem& directoryItem, int32_t address) const;
-        /// Saves directory item to the indirect link of given directory
-        void saveDirItemToIndirect(const fs::DirectoryItem& directoryItem, fs::Inode& directory);
-        /// Returns sub-index from a data block of direct links, where empty storage starts
-        [[nodiscard]] size_t getFreeIndirectLinkDataBlockSubindex(int32_t indirectLinkDatablockIndex) const;
-        /// Saves directory item to any free indirect link of given directory
-        void saveDirItemToFreeIndirectLink(const fs::DirectoryItem &directoryItem, fs::Inode& directory);
-        /// Checks if directory item data block is empty
-        [[nodiscard]] bool isDirItemIndexFree(int32_t index) const;
-        /// Checks if indirect link data block is empty
-        [[nodiscard]] bool isIndirectLinkFree(int32_t index) const;
-        /// Removes directory item from given data block
-        [[nodiscard]] fs::DirectoryItem removeDirItemFromCluster(const std::string &filename, int index) const;
+        /**
+         * Claims given cluster before it's first written after allocation. Clusters behind the initialized ones were
+         * never written since format and still read as zeros, so claiming them only moves the initialized count
+         * behind them, which is saved on @a flush. Clusters in front may still hold data of a removed file.
+         *
+         * @param index index of the allocated cluster
+         * @return true if the cluster may hold stale data and has to be zeroed where it's not overwritten
+         */
+        bool claimCluster(int32_t index);
+        /// Adds writes of given data into the data cluster with given index to the batch, zeroing the rest of the cluster if needed
+        void addDataClusterWrites(std::vector<pfs::WriteRequest>& writes, int32_t index, const std::string& data);
+        /// Writes given number of bytes read from given stream into given runs of clusters, zeroing the rest of the last cluster if needed
+        void saveStreamData(std::istream& stream, std::size_t size, const std::vector<fs::Extent>& runs);
+        /// Returns the number of blocks of extent tree holding given number of extents
+        [[nodiscard]] static std::size_t getExtentTreeBlockCount(std::size_t extentCount);
+        /// Adds writes of the extent tree holding given extents into given blocks to the batch, blocks are built in given list
+        void addExtentTreeWrites(std::vector<pfs::WriteRequest>& writes,
+                                 std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>>& treeClusters,
+                                 const std::vector<fs::Extent>& extents, const std::vector<int32_t>& treeBlocks);
+        /// Reads all extents of the extent tree with given root, storing the blocks of the tree into given vector
+        [[nodiscard]] std::vector<fs::Extent> readExtentTree(int32_t rootLink, std::vector<int32_t>& treeBlocks) const;
+        /**
+         * Reads all the links of given file mapped by links, reading every level of it's indirect, double indirect
+         * and triple indirect links as one batch.
+         *
+         * @param inode inode of the file
+         * @param indirectLinks output for the blocks holding links
+         * @return links to the data blocks in the order of the file data
+         */
+        [[nodiscard]] std::vector<int32_t> readLinkTrees(const fs::Inode& inode, std::vector<int32_t>& indirectLinks) const;
+        /**
+         * Adds writes of all the blocks of links of a file mapped by given blocks to the batch. Blocks of links
+         * are built in given list, given function is called with every data block in the order of the file data.
+         */
+        void addLinkWrites(std::vector<pfs::WriteRequest>& writes,
+                           std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>>& indirectClusters,
+                           const std::vector<int32_t>& dataClusterIndexes,
+                           const std::function<void(int32_t)>& addDataCluster);
+        /**
+         * Adds writes of the link tree of given depth to the batch, taking it's blocks from given position of the data
+         * blocks ordered the way they are linked and moving the position behind the tree. Blocks of links are built
+         * in given list, given function is called with every linked data block.
+         */
+        void addLinkTreeWrites(std::vector<pfs::WriteRequest>& writes,
+                               std::list<std::array<u_char, fs::Superblock::CLUSTER_SIZE>>& indirectClusters,
+                               std::size_t depth, std::vector<int32_t>::const_iterator& next,
+                               const std::vector<int32_t>::const_iterator& end,
+                               const std::function<void(int32_t)>& addDataCluster);
+        /// Returns the data allocation group matching the i-node group of given i-node
+        [[nodiscard]] std::size_t getGroup(const fs::Inode& inode) const;
+        /**
+         * Allocates given number of clusters for given i-node at once - either all of them are allocated or none.
+         *
+         * @param owner i-node the clusters are allocated for
+         * @param count number of clusters
+         * @return allocated clusters
+         * @throw ObjectNotFound if there is not enough free clusters
+         */
+        std::vector<int32_t> reserveClusters(const fs::Inode& owner, std::size_t count);
+        /// Reads the link stored in given entry of given block of links
+        [[nodiscard]] int32_t readLink(int32_t block, std::size_t entry) const;
+        /// Writes given allocated cluster as a block of links with every link empty
+        void initializeLinkBlock(int32_t block);
+        /**
+         * Returns the number of blocks of links that have to be allocated to link the data block on given position
+         * of given directory, reading only the links on the way.
+         *
+         * @throw ObjectNotFound if the position is out of the links of an i-node
+         */
+        [[nodiscard]] std::size_t getMissingLinkBlockCount(const fs::Inode& directory, std::size_t position) const;
+        /// Returns the cluster linked as the data block on given position of given directory, reading only the links on the way
+        [[nodiscard]] int32_t getDirectoryBlock(const fs::Inode& directory, std::size_t position) const;
+        /**
+         * Links given cluster as the data block on given position of given directory, taking the missing blocks
+         * of links on the way from given reserved clusters.
+         *
+         * @param directory directory to add the block to
+         * @param position position of the block in the directory data, the first cluster having position 0
+         * @param cluster cluster to link
+         * @param linkBlocks reserved clusters, at least @a getMissingLinkBlockCount of them, the used ones are removed
+         * @throw ObjectNotFound if the position is out of the links of an i-node
+         */
+        void addDirectoryBlock(fs::Inode& directory, std::size_t position, int32_t cluster,
+                               std::vector<int32_t>& linkBlocks);
+        /// Reads the index header from the first cluster of given directory
+        [[nodiscard]] fs::DirectoryHeader readDirectoryHeader(const fs::Inode& directory) const;
+        /// Writes the index header into the first cluster of given directory
+        void writeDirectoryHeader(const fs::Inode& directory, const fs::DirectoryHeader& header);
+        /// Returns the cluster of the bucket selected by given name hash, reading only one entry of the bucket table
+        [[nodiscard]] int32_t findBucket(const fs::DirectoryHeader& header, uint32_t hash) const;
+        /// Reads the whole bucket table of a directory
+        [[nodiscard]] std::vector<int32_t> readBucketTable(const fs::DirectoryHeader& header) const;
+        /// Reads the bucket stored in given cluster
+        [[nodiscard]] fs::DirectoryBucket readBucket(int32_t cluster) const;
+        /// Returns the bitmap of used slots of the bucket in given cluster, reading the bucket if it's not known yet
+        SlotBitmap& getBucketSlots(int32_t cluster);
+        /// Creates the first bucket and the bucket table of given directory
+        void createFirstBucket(fs::Inode& directory, fs::DirectoryHeader& header);
+        /**
+         * Splits given full bucket of given directory by the next bit of the name hashes, doubling the bucket table
+         * if the bucket is already selected by a single entry. Items with the bit set are moved into a new bucket.
+         *
+         * @param directory directory of the bucket
+         * @param header index header of the directory, updated by the split
+         * @param cluster cluster of the split bucket
+         * @param bucket the split bucket
+         * @throw ObjectNotFound if the bucket table can't grow any more or there is not enough free clusters,
+         * the directory is left unchanged then
+         */
+        void splitBucket(fs::Inode& directory, fs::DirectoryHeader& header, int32_t cluster, const fs::DirectoryBucket& bucket);
 
     };
 }
@@ -0,0 +1,61 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include "DentryCache.h"
+
+pfs::DentryCache::DentryCache(const std::size_t capacity) : m_capacity(capacity) {}
+
+const int32_t *pfs::DentryCache::find(const int32_t parentId, const std::string &name) const {
+    auto it = m_entryIndex.find({ parentId, name });
+    if (it == m_entryIndex.end()) {
+        m_misses++;
+        return nullptr;
+    }
+
+    m_hits++;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->inodeId;
+}
+
+void pfs::DentryCache::put(const int32_t parentId, const std::string &name, const int32_t inodeId) const {
+    if (m_capacity == 0) {
+        return;
+    }
+
+    Key key { parentId, name };
+    auto it = m_entryIndex.find(key);
+    if (it != m_entryIndex.end()) {
+        it->second->inodeId = inodeId;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return;
+    }
+
+    m_entries.push_front({ key, inodeId });
+    m_entryIndex[key] = m_entries.begin();
+
+    while (m_entries.size() > m_capacity) {
+        m_entryIndex.erase(m_entries.back().key);
+        m_entries.pop_back();
+    }
+}
+
+void pfs::DentryCache::eraseDirectory(const int32_t parentId) {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->key.parentId == parentId) {
+            m_entryIndex.erase(it->key);
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+pfs::CacheStatistics pfs::DentryCache::getStatistics() const {
+    CacheStatistics statistics;
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+    statistics.cached = m_entries.size();
+    statistics.capacity = m_capacity;
+    return statistics;
+}
@@ -0,0 +1,109 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_DENTRYCACHE_H
+#define PRIMITIVE_FS_DENTRYCACHE_H
+
+#include <list>
+#include <string>
+#include <unordered_map>
+#include "BufferCache.h"
+#include "../common/structures.h"
+
+namespace pfs {
+
+    /**
+     * Cache of resolved directory items with fixed budget, keyed by the i-node ID of the parent directory and the name
+     * of the item. Names missing in their directory are cached as well, as negative entries. The cache is never written
+     * anywhere, the owner has to update it on every change of a directory. When the budget is exceeded, least recently
+     * used entries are evicted.
+     */
+    class DentryCache {
+    private: // private attributes
+        /**
+         * Name of an item in it's parent directory.
+         */
+        struct Key {
+            /// I-node ID of the parent directory
+            int32_t parentId;
+            /// Name of the item
+            std::string name;
+
+            bool operator==(const Key& other) const {
+                return parentId == other.parentId && name == other.name;
+            }
+        };
+
+        /**
+         * Hash of a key, combining the hashes of it's parts.
+         */
+        struct KeyHash {
+            std::size_t operator()(const Key& key) const {
+                return std::hash<std::string>()(key.name) * 31 + std::hash<int32_t>()(key.parentId);
+            }
+        };
+
+        /**
+         * One cached directory item.
+         */
+        struct Entry {
+            /// Parent directory and name of the item
+            Key key;
+            /// I-node ID of the item, fs::FREE_INODE_ID if the name is missing in the directory
+            int32_t inodeId;
+        };
+
+        /// Maximal number of cached entries
+        std::size_t m_capacity = 0;
+        /// Cached entries, most recently used at the front
+        mutable std::list<Entry> m_entries;
+        /// Cached entries by their keys
+        mutable std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_entryIndex;
+        /// Number of lookups served from the cache
+        mutable std::size_t m_hits = 0;
+        /// Number of lookups that missed the cache
+        mutable std::size_t m_misses = 0;
+
+    public: // public methods
+        DentryCache() = default;
+        /**
+         * Creates an empty cache.
+         *
+         * @param capacity maximal number of cached entries, zero disables caching
+         */
+        explicit DentryCache(std::size_t capacity);
+        /**
+         * Returns cached i-node ID of the item with given name in given directory and marks the entry as the most
+         * recently used one.
+         *
+         * @param parentId i-node ID of the directory
+         * @param name name of the item
+         * @return cached i-node ID, fs::FREE_INODE_ID for a cached missing name or null if the name is not cached
+         */
+        [[nodiscard]] const int32_t* find(int32_t parentId, const std::string& name) const;
+        /**
+         * Stores the i-node ID of the item with given name in given directory as the most recently used entry,
+         * replacing the cached one.
+         *
+         * @param parentId i-node ID of the directory
+         * @param name name of the item
+         * @param inodeId i-node ID of the item, fs::FREE_INODE_ID if the name is missing in the directory
+         */
+        void put(int32_t parentId, const std::string& name, int32_t inodeId) const;
+        /**
+         * Drops all entries of the directory with given i-node ID, so they can't be found after the ID is reused.
+         *
+         * @param parentId i-node ID of the removed directory
+         */
+        void eraseDirectory(int32_t parentId);
+        /**
+         * Returns current statistics of this cache. Entries are never dirty.
+         *
+         * @return cache statistics
+         */
+        [[nodiscard]] CacheStatistics getStatistics() const;
+    };
+}
+
+#endif //PRIMITIVE_FS_DENTRYCACHE_H
@@ -0,0 +1,39 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include "DirectoryCursor.h"
+
+pfs::DirectoryCursor::DirectoryCursor(const pfs::DataService &dataService, const fs::Inode &directory,
+                                      const pfs::DirectoryPosition position)
+                                      : m_dataService(&dataService), m_directory(directory),
+                                      m_blockCount(dataService.getDirectoryBlockCount(directory)), m_position(position) {
+}
+
+bool pfs::DirectoryCursor::next(fs::DirectoryItem &item) {
+    while (m_position.block < m_blockCount) {
+        if (!m_blockRead) {
+            m_block = m_dataService->readDirectoryBlock(m_directory, m_position.block);
+            m_blockRead = true;
+        }
+
+        const auto &items = m_block.getItems();
+        while (m_position.slot < items.size()) {
+            const fs::DirectoryItem &candidate = items[m_position.slot++];
+            if (!candidate.isFree()) {
+                item = candidate;
+                return true;
+            }
+        }
+
+        m_position.block++;
+        m_position.slot = 0;
+        m_blockRead = false;
+    }
+
+    return false;
+}
+
+const pfs::DirectoryPosition &pfs::DirectoryCursor::getPosition() const {
+    return m_position;
+}
@@ -0,0 +1,71 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_DIRECTORYCURSOR_H
+#define PRIMITIVE_FS_DIRECTORYCURSOR_H
+
+#include "DataService.h"
+#include "../common/structures.h"
+
+namespace pfs {
+
+    /**
+     * Position of a directory cursor - the cluster of the directory and the slot in it, where the next item is looked for.
+     * The position stays valid when the directory is changed, items saved into the passed slots are just not listed.
+     */
+    struct DirectoryPosition {
+        /// Position of the cluster in the directory data, the first cluster having position 0
+        std::size_t block = 0;
+        /// Slot of the cluster where the next item is looked for
+        std::size_t slot = 0;
+    };
+
+    /**
+     * Cursor walking the items of a directory cluster by cluster. Only the cluster under the cursor is kept
+     * in the memory, so even huge directories are listed in constant memory and their first items are available
+     * right after the first cluster is read. The walk may be resumed by a new cursor from a returned position.
+     */
+    class DirectoryCursor {
+    private: // private attributes
+        /// Service reading the clusters of the directory
+        const DataService* m_dataService = nullptr;
+        /// Listed directory
+        fs::Inode m_directory;
+        /// Number of clusters holding the items of the directory
+        std::size_t m_blockCount = 0;
+        /// Position of the next item
+        DirectoryPosition m_position;
+        /// Items of the cluster under the cursor
+        fs::DirectoryBucket m_block;
+        /// Is the cluster under the cursor read already?
+        bool m_blockRead = false;
+
+    public: // public methods
+        DirectoryCursor() = default;
+        /**
+         * Creates a cursor at given position of given directory.
+         *
+         * @param dataService service reading the clusters of the directory, has to outlive the cursor
+         * @param directory directory to list
+         * @param position position to start at, the first item by default
+         * @throw invalid_argument if given i-node is not a directory
+         */
+        DirectoryCursor(const DataService& dataService, const fs::Inode& directory, DirectoryPosition position = {});
+        /**
+         * Moves the cursor to the next item of the directory.
+         *
+         * @param item filled with the next item
+         * @return true if an item was found, false if the whole directory was listed
+         */
+        bool next(fs::DirectoryItem& item);
+        /**
+         * Returns the position of the next item, a new cursor created with it continues where this one stopped.
+         *
+         * @return position of the cursor
+         */
+        [[nodiscard]] const DirectoryPosition& getPosition() const;
+    };
+}
+
+#endif //PRIMITIVE_FS_DIRECTORYCURSOR_H
@@ -0,0 +1,200 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ios>
+#include "FileBlockDevice.h"
+
+namespace {
+    template<typename Request>
+    std::vector<const Request*> sortByAddress(const std::vector<Request>& requests) {
+        std::vector<const Request*> sorted;
+        for (const auto &request : requests) {
+            if (request.length > 0) {
+                sorted.push_back(&request);
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const Request* first, const Request* second) {
+            return first->address < second->address;
+        });
+        return sorted;
+    }
+
+    /// Merges requests sorted by their addresses into runs of at most IOV_MAX buffers
+    template<typename Run, typename Request>
+    std::vector<Run> mergeSorted(const std::vector<const Request*>& sorted) {
+        std::vector<Run> runs;
+        std::size_t runEnd = 0;
+        for (const auto &request : sorted) {
+            if (runs.empty() || runEnd != request->address || runs.back().vectors.size() == IOV_MAX) {
+                runs.push_back({ request->address, {} });
+            }
+            runs.back().vectors.push_back({ const_cast<void*>(static_cast<const void*>(request->buffer)), request->length });
+            runEnd = request->address + request->length;
+        }
+        return runs;
+    }
+
+    /// Skips given number of bytes from the start of given buffers
+    void skipBytes(std::vector<iovec>& vectors, std::size_t& first, std::size_t bytes) {
+        while (first < vectors.size() && bytes >= vectors[first].iov_len) {
+            bytes -= vectors[first].iov_len;
+            first++;
+        }
+        if (bytes > 0) {
+            vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + bytes;
+            vectors[first].iov_len -= bytes;
+        }
+    }
+}
+
+pfs::FileBlockDevice::FileBlockDevice(const std::string &fileName, const bool truncate, const std::size_t size) {
+    int flags = O_RDWR;
+    if (truncate) {
+        flags |= O_CREAT | O_TRUNC;
+    }
+
+    m_fd = ::open(fileName.c_str(), flags, 0644);
+    if (m_fd < 0) {
+        throw std::ios_base::failure("Chyba při otevírání datového souboru");
+    }
+
+    if (truncate && ::ftruncate(m_fd, size) < 0) {
+        ::close(m_fd);
+        throw std::ios_base::failure("Chyba při změně velikosti datového souboru");
+    }
+}
+
+pfs::FileBlockDevice::~FileBlockDevice() {
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void pfs::FileBlockDevice::read(std::size_t address, void *buffer, std::size_t length) const {
+    auto* position = static_cast<char*>(buffer);
+    while (length > 0) {
+        ssize_t bytesRead = ::pread(m_fd, position, length, address);
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::ios_base::failure("Chyba při čtení z datového souboru");
+        }
+
+        if (bytesRead == 0) {
+            /// We got behind the end of the data file, there is nothing stored yet
+            std::memset(position, 0, length);
+            return;
+        }
+
+        position += bytesRead;
+        address += bytesRead;
+        length -= bytesRead;
+    }
+}
+
+void pfs::FileBlockDevice::write(std::size_t address, const void *buffer, std::size_t length) {
+    const auto* position = static_cast<const char*>(buffer);
+    while (length > 0) {
+        ssize_t bytesWritten = ::pwrite(m_fd, position, length, address);
+        if (bytesWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::ios_base::failure("Chyba při zápisu do datového souboru");
+        }
+
+        position += bytesWritten;
+        address += bytesWritten;
+        length -= bytesWritten;
+    }
+}
+
+void pfs::FileBlockDevice::readBatch(const std::vector<ReadRequest> &requests) const {
+    for (const auto &run : mergeRuns(requests)) {
+        readRun(run, 0);
+    }
+}
+
+void pfs::FileBlockDevice::writeBatch(const std::vector<WriteRequest> &requests) {
+    for (const auto &run : mergeRuns(requests)) {
+        writeRun(run, 0);
+    }
+}
+
+std::vector<pfs::FileBlockDevice::IoRun> pfs::FileBlockDevice::mergeRuns(const std::vector<ReadRequest> &requests) {
+    return mergeSorted<IoRun>(sortByAddress(requests));
+}
+
+std::vector<pfs::FileBlockDevice::IoRun> pfs::FileBlockDevice::mergeRuns(const std::vector<WriteRequest> &requests) {
+    return mergeSorted<IoRun>(sortByAddress(requests));
+}
+
+void pfs::FileBlockDevice::readRun(const IoRun &run, std::size_t transferred) const {
+    std::vector<iovec> vectors = run.vectors;
+    std::size_t first = 0;
+    skipBytes(vectors, first, transferred);
+    while (first < vectors.size()) {
+        ssize_t bytesRead = ::preadv(m_fd, vectors.data() + first, static_cast<int>(vectors.size() - first),
+                                     static_cast<off_t>(run.address + transferred));
+        if (bytesRead < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::ios_base::failure("Chyba při čtení z datového souboru");
+        }
+
+        if (bytesRead == 0) {
+            /// We got behind the end of the data file, there is nothing stored yet
+            for (; first < vectors.size(); ++first) {
+                std::memset(vectors[first].iov_base, 0, vectors[first].iov_len);
+            }
+            return;
+        }
+
+        transferred += bytesRead;
+        skipBytes(vectors, first, bytesRead);
+    }
+}
+
+void pfs::FileBlockDevice::writeRun(const IoRun &run, std::size_t transferred) {
+    std::vector<iovec> vectors = run.vectors;
+    std::size_t first = 0;
+    skipBytes(vectors, first, transferred);
+    while (first < vectors.size()) {
+        ssize_t bytesWritten = ::pwritev(m_fd, vectors.data() + first, static_cast<int>(vectors.size() - first),
+                                         static_cast<off_t>(run.address + transferred));
+        if (bytesWritten < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::ios_base::failure("Chyba při zápisu do datového souboru");
+        }
+
+        transferred += bytesWritten;
+        skipBytes(vectors, first, bytesWritten);
+    }
+}
+
+void pfs::FileBlockDevice::sync() {
+    if (::fsync(m_fd) < 0) {
+        throw std::ios_base::failure("Chyba při synchronizaci datového souboru");
+    }
+}
+
+std::size_t pfs::FileBlockDevice::size() const {
+    struct stat fileStat {};
+    if (::fstat(m_fd, &fileStat) < 0) {
+        throw std::ios_base::failure("Chyba při zjišťování velikosti datového souboru");
+    }
+
+    return fileStat.st_size;
+}
@@ -0,0 +1,78 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_FILEBLOCKDEVICE_H
+#define PRIMITIVE_FS_FILEBLOCKDEVICE_H
+
+#include <sys/uio.h>
+#include "BlockDevice.h"
+
+namespace pfs {
+
+    /**
+     * Block device holding exactly one open descriptor of the data file and performing positioned reads
+     * and writes (pread/pwrite) on it. Batched requests with adjacent addresses are merged into runs, each moved
+     * by one vectored read or write (preadv/pwritev).
+     */
+    class FileBlockDevice : public BlockDevice {
+    protected: // protected attributes
+        /**
+         * Requests with adjacent addresses merged into one vectored transfer.
+         */
+        struct IoRun {
+            /// Address of the first byte of the run
+            std::size_t address;
+            /// Buffers of the merged requests in the order of their addresses
+            std::vector<iovec> vectors;
+        };
+
+        /// Descriptor of the opened data file
+        int m_fd = -1;
+
+    public: // public methods
+        /**
+         * Opens the data file with given name for reading and writing. If @a truncate is true, the data file
+         * is created if it does not exist, it's previous content is discarded and it is resized to @a size bytes.
+         *
+         * @param fileName name of the data file
+         * @param truncate should the data file be created or truncated?
+         * @param size size of the truncated data file
+         * @throw std::ios_base::failure if the data file cannot be opened
+         */
+        FileBlockDevice(const std::string& fileName, bool truncate, std::size_t size);
+        ~FileBlockDevice() override;
+
+        void read(std::size_t address, void* buffer, std::size_t length) const override;
+        void write(std::size_t address, const void* buffer, std::size_t length) override;
+        void readBatch(const std::vector<ReadRequest>& requests) const override;
+        void writeBatch(const std::vector<WriteRequest>& requests) override;
+        void sync() override;
+        [[nodiscard]] std::size_t size() const override;
+
+    protected: // protected methods
+        /// Sorts given requests by their addresses and merges the adjacent ones into runs
+        static std::vector<IoRun> mergeRuns(const std::vector<ReadRequest>& requests);
+        /// Sorts given requests by their addresses and merges the adjacent ones into runs
+        static std::vector<IoRun> mergeRuns(const std::vector<WriteRequest>& requests);
+        /**
+         * Reads given run, skipping first @a transferred bytes which are already read. Bytes beyond the end
+         * of the data file are read as zeros.
+         *
+         * @param run run to read
+         * @param transferred number of bytes of the run already read
+         * @throw std::ios_base::failure if the reading fails
+         */
+        void readRun(const IoRun& run, std::size_t transferred) const;
+        /**
+         * Writes given run, skipping first @a transferred bytes which are already written.
+         *
+         * @param run run to write
+         * @param transferred number of bytes of the run already written
+         * @throw std::ios_base::failure if the writing fails
+         */
+        void writeRun(const IoRun& run, std::size_t transferred);
+    };
+}
+
+#endif //PRIMITIVE_FS_FILEBLOCKDEVICE_H
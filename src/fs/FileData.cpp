@@ -2,6 +2,7 @@
 // Author: markovd@students.zcu.cz
 //
 
+#include <algorithm>
 #include "FileData.h"
 
 namespace fs {
@@ -48,18 +49,33 @@ namespace fs {
     }
 
     size_t ClusteredFileData::requiredDataBlocks() const noexcept {
-        size_t clusterCount = size();
+        return requiredDataBlocks(size());
+    }
+
+    size_t ClusteredFileData::requiredDataBlocks(const size_t clusterCount) noexcept {
         if (clusterCount <= fs::Inode::DIRECT_LINKS_COUNT) {
             return clusterCount;
         }
 
-        size_t requiredDataBlocks = clusterCount + ((clusterCount - fs::Inode::DIRECT_LINKS_COUNT) / fs::Inode::LINKS_IN_INDIRECT);
-        if (((clusterCount - fs::Inode::DIRECT_LINKS_COUNT) % fs::Inode::LINKS_IN_INDIRECT) != 0) {
-            requiredDataBlocks++; /// Adding one data block for indirect link to store the links in remainder
+        size_t requiredDataBlocks = clusterCount;
+        size_t remaining = clusterCount - fs::Inode::DIRECT_LINKS_COUNT;
+        for (size_t depth : fs::DataLinks::TREE_DEPTHS) {
+            size_t capacity = 1;
+            for (size_t level = 0; level < depth; ++level) {
+                capacity *= fs::Inode::LINKS_IN_INDIRECT;
+            }
+
+            /// Every level of the tree needs one block of links for every LINKS_IN_INDIRECT blocks of the level below
+            size_t linked = std::min(remaining, capacity);
+            size_t blocks = linked;
+            for (size_t level = 0; level < depth; ++level) {
+                blocks = (blocks + fs::Inode::LINKS_IN_INDIRECT - 1) / fs::Inode::LINKS_IN_INDIRECT;
+                requiredDataBlocks += blocks;
+            }
+            remaining -= linked;
         }
 
         return requiredDataBlocks;
-
     }
 
     size_t ClusteredFileData::size() const noexcept {
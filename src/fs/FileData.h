@@ -89,14 +89,24 @@ namespace fs {
         [[nodiscard]] const std::string& at(size_t index) const;
 
         /**
-         * Returns a number of required data blocks required to store the data contained by this instance. It takes to account
-         * that an inode has only @a fs::Inode::DIRECT_LINKS_COUNT of direct links and needs additional data blocks to
-         * store indirect links if there is more data to be stored.
+         * Returns a number of required data blocks required to store the data contained by this instance, if it's mapped
+         * by links. It takes to account that an inode has only @a fs::Inode::DIRECT_LINKS_COUNT of direct links and needs
+         * additional data blocks to store indirect, double indirect and triple indirect links if there is more data to be stored. Files mapped by extents need
+         * only @a size data blocks, unless they are split into more extents than fit into the inode.
          *
          * @return number of required data blocks to store contained data
          */
         [[nodiscard]] size_t requiredDataBlocks() const noexcept;
 
+        /**
+         * Returns a number of data blocks required to store given number of clusters of data mapped by links,
+         * blocks of indirect links included. See @a requiredDataBlocks.
+         *
+         * @param clusterCount number of clusters of data
+         * @return number of required data blocks
+         */
+        [[nodiscard]] static size_t requiredDataBlocks(size_t clusterCount) noexcept;
+
         /**
          * Returns number of clusters stored.
          *
@@ -6,33 +6,129 @@
 #include <filesystem>
 #include <vector>
 #include <algorithm>
+#include <tuple>
+#include <map>
 #include "FileSystem.h"
 #include "../utils/FilePathUtils.h"
 #include "../utils/InvalidState.h"
 #include "../command/returnval.h"
 
+FileSystem::~FileSystem() {
+    closeDevice();
+}
+
+bool FileSystem::openDevice(const bool truncate, const std::size_t size) {
+    closeDevice();
+    try {
+        m_device = pfs::BlockDevice::open(m_dataFileName, m_options.ioBackend, truncate, size);
+    } catch (const std::exception& ex) {
+        return false;
+    }
+
+    if (truncate) {
+        m_device->setDataStartAddress(m_superblock.getDataStartAddress());
+    } else {
+        m_superblock.load(*m_device, 0);
+        if (m_superblock.getFormatVersion() != fs::Superblock::FORMAT_VERSION) {
+            std::cout << "Datový soubor má nepodporovanou verzi formátu, je nutné jej znovu naformátovat!\n";
+            m_device.reset();
+            return false;
+        }
+        m_device->setDataStartAddress(m_superblock.getDataStartAddress());
+    }
+
+    if (m_options.cacheClusters > 0) {
+        m_cache = std::make_shared<pfs::BufferCache>(m_device, m_options.cacheClusters);
+        m_device = m_cache;
+    }
+    m_dentryCache = pfs::DentryCache(m_options.cacheDentries);
+    return true;
+}
+
+void FileSystem::closeDevice() {
+    try {
+        flush();
+    } catch (const std::exception& ex) {
+        std::cout << "Chyba při zápisu bitmap: " << ex.what() << '\n';
+    }
+    /// Services have to release the device as well, so the cache is written back before the data file is closed
+    m_inodeService = pfs::InodeService();
+    m_dataService = pfs::DataService();
+    m_dentryCache = pfs::DentryCache();
+    m_directorySizeDeltas.clear();
+    m_cache.reset();
+    m_device.reset();
+    m_initialized = false;
+}
+
+void FileSystem::flush() {
+    applyDirectorySizes();
+    m_inodeService.flush();
+    m_dataService.flush();
+}
+
+void FileSystem::sync() {
+    flush();
+    if (m_device) {
+        m_device->sync();
+    }
+}
+
+void FileSystem::printInodeCacheStatistics() const {
+    pfs::CacheStatistics statistics = m_inodeService.getCacheStatistics();
+    std::size_t lookups = statistics.hits + statistics.misses;
+    std::cout << "Hits: " << statistics.hits << " - Misses: " << statistics.misses << " - Hit ratio: "
+              << (lookups ? (100 * statistics.hits / lookups) : 0) << "% - Cached i-nodes: " << statistics.cached
+              << "/" << statistics.capacity << " - Dirty i-nodes: " << statistics.dirty << '\n';
+}
+
+void FileSystem::printDentryCacheStatistics() const {
+    pfs::CacheStatistics statistics = m_dentryCache.getStatistics();
+    std::size_t lookups = statistics.hits + statistics.misses;
+    std::cout << "Hits: " << statistics.hits << " - Misses: " << statistics.misses << " - Hit ratio: "
+              << (lookups ? (100 * statistics.hits / lookups) : 0) << "% - Cached items: " << statistics.cached
+              << "/" << statistics.capacity << '\n';
+}
+
+void FileSystem::printCacheStatistics() const {
+    if (!m_cache) {
+        std::cout << "Buffer cache is disabled\n";
+        return;
+    }
+
+    pfs::CacheStatistics statistics = m_cache->getStatistics();
+    std::size_t lookups = statistics.hits + statistics.misses;
+    std::cout << "Hits: " << statistics.hits << " - Misses: " << statistics.misses << " - Hit ratio: "
+              << (lookups ? (100 * statistics.hits / lookups) : 0) << "% - Cached clusters: " << statistics.cached
+              << "/" << statistics.capacity << " - Dirty clusters: " << statistics.dirty << '\n';
+}
+
 bool FileSystem::initialize(fs::Superblock &sb) {
+    if (sb.getFormatVersion() != fs::Superblock::FORMAT_VERSION) {
+        /// Super-block of invalid size is left unfilled
+        return false;
+    }
 
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::binary);
-    if (!dataFile) {
+    m_superblock = sb;
+    if (!openDevice(true, sb.getDiskSize())) {
         return false;
     }
     /**
      * First we write superblock at the start of the filesystem
      */
-    if(!writeSuperblock(dataFile, sb)) {
+    if(!writeSuperblock(sb)) {
         std::cout << "Error while writing superblock!\n";
         return false;
     }
     /**
      * Then we write i-node and data bitmap
      */
-    if (!initializeInodeBitmap(dataFile)) {
+    if (!initializeInodeBitmap()) {
         std::cout << "Error while writing i-node bitmap!\n";
         return false;
     }
 
-    if (!initializeDataBitmap(dataFile)) {
+    if (!initializeDataBitmap()) {
         std::cout << "Error while writing data-block bitmap!\n";
         return false;
     }
@@ -40,13 +136,11 @@ bool FileSystem::initialize(fs::Superblock &sb) {
      * After initialization, there will be only root i-node
      */
     fs::Inode rootInode(0, true, 0);
+    rootInode.setParentId(0);
     rootInode.addDirectLink(0); /// We add direct link to the first data block, where the root folder data will be
 
-    rootInode.save(dataFile, m_superblock.getInodeStartAddress());
-    /// We fill the empty i-node space
-    for (size_t i = (m_superblock.getInodeStartAddress() + sizeof(fs::Inode)); i < m_superblock.getDataStartAddress(); ++i) {
-        dataFile.put('\0');
-    }
+    /// The rest of the i-node space is left sparse, freshly sized data file reads as zeros
+    rootInode.save(*m_device, m_superblock.getInodeStartAddress());
 
     /**
      * Creating content of the root directory:
@@ -55,17 +149,12 @@ bool FileSystem::initialize(fs::Superblock &sb) {
      * +..
      *
      */
-    fs::DirectoryItem rootSelf(pfs::path::SELF, 0);
-    rootSelf.save(dataFile, m_superblock.getDataStartAddress());
-    fs::DirectoryItem rootParent(pfs::path::PARENT, 0);
-    rootParent.save(dataFile, dataFile.tellp());
-
-    /// We fill the empty data space
-    for (size_t i = (m_superblock.getDataStartAddress() + 2 * sizeof(fs::DirectoryItem)); i < sb.getDiskSize(); ++i) {
-        dataFile.put('\0');
-    }
+    fs::DirectoryItem rootSelf(pfs::path::SELF, 0, fs::FileType::DIRECTORY);
+    rootSelf.save(*m_device, m_superblock.getDataStartAddress());
+    fs::DirectoryItem rootParent(pfs::path::PARENT, 0, fs::FileType::DIRECTORY);
+    rootParent.save(*m_device, m_superblock.getDataStartAddress() + fs::DirectoryItem::DISK_SIZE);
+    /// The data space is left sparse as well, clusters are zeroed only when they are allocated again after being freed
 
-    dataFile.flush();
     /// In the end we are successfully initialized
     m_currentDirPath = "/";
     m_currentDirInode = rootInode;
@@ -74,18 +163,17 @@ bool FileSystem::initialize(fs::Superblock &sb) {
 }
 
 bool FileSystem::initializeFromExisting() {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
+    /// Opening the device loads the superblock as well
+    if (!openDevice(false)) {
         return false;
     }
 
-    m_superblock.load(dataFile, 0);
-    if (!initializeInodeBitmap(dataFile)) {
+    if (!loadInodeBitmap()) {
         std::cout << "Error while reading inode bitmap from the data file!\n";
         return false;
     }
 
-    if (!initializeDataBitmap(dataFile)) {
+    if (!loadDataBitmap()) {
         std::cout << "Error while reading data bitmap from the data file!\n";
         return false;
     }
@@ -93,124 +181,204 @@ bool FileSystem::initializeFromExisting() {
     /// By default we start in the root directory.
     m_currentDirPath = "/";
     /// Load the inode representing current directory
-    m_currentDirInode.load(dataFile, m_superblock.getInodeStartAddress());
+    m_inodeService.getRootInode(m_currentDirInode);
     std::cout << "Initialized from existing file!\n";
     /// In the end we are successfully initialized
     m_initialized = true;
     return true;
 }
 
-bool FileSystem::writeSuperblock(std::fstream& dataFile, fs::Superblock &sb) {
-    if (!dataFile.is_open()) {
+bool FileSystem::writeSuperblock(fs::Superblock &sb) {
+    if (!m_device) {
         return false;
     }
     m_superblock = sb;
      /// Superblock has to be at the start of the file-system.
-    m_superblock.save(dataFile, 0);
+    m_superblock.save(*m_device, 0);
 
-    return !dataFile.bad();
+    return true;
 }
 
-bool FileSystem::initializeInodeBitmap(std::fstream& dataFile) {
-    if (!dataFile.is_open()) {
+bool FileSystem::initializeInodeBitmap() {
+    if (!m_device) {
         return false;
     }
 
-    fs::Bitmap inodeBitmap(m_superblock.getDataBitmapStartAddress() - m_superblock.getInodeBitmapStartAddress());
+    pfs::GroupedBitmap inodeBitmap(m_superblock.getDataBitmapStartAddress() - m_superblock.getInodeBitmapStartAddress(),
+                            m_superblock.getInodesPerGroup(), m_superblock.getInodeCount());
     inodeBitmap.setIndexFilled(0);
-    inodeBitmap.save(dataFile, m_superblock.getInodeBitmapStartAddress());
-    m_inodeService = pfs::InodeService(m_dataFileName, inodeBitmap,
-                                       m_superblock.getInodeBitmapStartAddress(), m_superblock.getInodeStartAddress());
-    return !dataFile.bad();
+    inodeBitmap.save(*m_device, m_superblock.getInodeBitmapStartAddress());
+    m_inodeService = pfs::InodeService(m_device, m_superblock, std::move(inodeBitmap), m_options.cacheInodes);
+    return true;
 }
 
-bool FileSystem::initializeInodeBitmap(std::ifstream& dataFile) {
-    if (!dataFile.is_open()) {
+bool FileSystem::loadInodeBitmap() {
+    if (!m_device) {
         return false;
     }
 
-    fs::Bitmap inodeBitmap(m_superblock.getDataBitmapStartAddress() - m_superblock.getInodeBitmapStartAddress());
-    inodeBitmap.load(dataFile, m_superblock.getInodeBitmapStartAddress());
-    m_inodeService = pfs::InodeService(m_dataFileName, inodeBitmap,
-                                       m_superblock.getInodeBitmapStartAddress(), m_superblock.getInodeStartAddress());
-    return !dataFile.bad();
+    pfs::GroupedBitmap inodeBitmap(m_superblock.getDataBitmapStartAddress() - m_superblock.getInodeBitmapStartAddress(),
+                            m_superblock.getInodesPerGroup(), m_superblock.getInodeCount());
+    inodeBitmap.load(*m_device, m_superblock.getInodeBitmapStartAddress());
+    m_inodeService = pfs::InodeService(m_device, m_superblock, std::move(inodeBitmap), m_options.cacheInodes);
+    return true;
 }
 
-bool FileSystem::initializeDataBitmap(std::fstream& dataFile) {
-    if (!dataFile.is_open()) {
+bool FileSystem::initializeDataBitmap() {
+    if (!m_device) {
         return false;
     }
 
-    fs::Bitmap dataBitmap(m_superblock.getInodeStartAddress() - m_superblock.getDataBitmapStartAddress());
+    pfs::GroupedBitmap dataBitmap(m_superblock.getInodeStartAddress() - m_superblock.getDataBitmapStartAddress(),
+                            fs::Superblock::CLUSTERS_PER_GROUP, m_superblock.getClusterCount());
     dataBitmap.setIndexFilled(0);
-    dataBitmap.save(dataFile, m_superblock.getDataBitmapStartAddress());
-    m_dataService = pfs::DataService(m_dataFileName, dataBitmap,
-                                     m_superblock.getDataBitmapStartAddress(),m_superblock.getDataStartAddress());
-    return !dataFile.bad();
+    dataBitmap.save(*m_device, m_superblock.getDataBitmapStartAddress());
+    m_dataService = pfs::DataService(m_device, m_superblock, std::move(dataBitmap));
+    return true;
 }
 
-bool FileSystem::initializeDataBitmap(std::ifstream& dataFile) {
-    if (!dataFile.is_open()) {
+bool FileSystem::loadDataBitmap() {
+    if (!m_device) {
         return false;
     }
 
-    fs::Bitmap dataBitmap(m_superblock.getInodeStartAddress() - m_superblock.getDataBitmapStartAddress());
-    dataBitmap.load(dataFile, m_superblock.getDataBitmapStartAddress());
-    m_dataService = pfs::DataService(m_dataFileName, dataBitmap,
-                                     m_superblock.getDataBitmapStartAddress(),m_superblock.getDataStartAddress());
-    return !dataFile.bad();
+    pfs::GroupedBitmap dataBitmap(m_superblock.getInodeStartAddress() - m_superblock.getDataBitmapStartAddress(),
+                            fs::Superblock::CLUSTERS_PER_GROUP, m_superblock.getClusterCount());
+    dataBitmap.load(*m_device, m_superblock.getDataBitmapStartAddress());
+    m_dataService = pfs::DataService(m_device, m_superblock, std::move(dataBitmap));
+    return true;
 }
 
 void FileSystem::createFile(const std::filesystem::path &path, const fs::FileData &fileData) {
-    if (!path.has_filename()) {
-        throw std::invalid_argument("Předaná cesta nekončí názvem souboru");
+    auto [directory, name] = lookupNewFile(path);
+    fs::Inode inode(createFileInode(directory, fileData.size()));
+
+    if (fileData.size() <= fs::Inode::INLINE_DATA_SIZE) {
+        /// Tiny files are stored in their i-node, they take no cluster and are read with the i-node
+        inode.setInlineData(fileData.data());
+        m_inodeService.saveInode(inode);
+        linkFile(directory, name, inode);
+        return;
     }
 
-    if (path.filename().string().size() > 11) {
-        throw std::invalid_argument("Název souboru smí být maximálně 11 znaků dlouhý!");
+    fs::ClusteredFileData clusteredData(fileData);
+    bool mapped = false;
+    try {
+        if (m_options.fileMapping == pfs::FileMapping::EXTENTS) {
+            /// Extents need only the data clusters, unless the file is too fragmented to fit them into the i-node
+            std::vector<int32_t> treeBlocks;
+            std::vector<fs::Extent> extents(m_dataService.allocateExtents(clusteredData.size(), inode, treeBlocks));
+            mapped = true;
+            m_dataService.saveFileData(clusteredData, extents, treeBlocks, inode);
+        } else {
+            std::vector<int32_t> dataClusterIndexes(
+                    m_dataService.allocateDataBlocks(clusteredData.requiredDataBlocks(), inode));
+            inode.setData(fs::DataLinks(dataClusterIndexes));
+            mapped = true;
+            m_dataService.saveFileData(clusteredData, dataClusterIndexes);
+        }
+    } catch (const std::exception &ex) {
+        /// Clusters already allocated for the file are freed through the i-node together with it
+        if (mapped) {
+            m_dataService.clearInodeData(inode);
+        }
+        m_inodeService.removeInode(inode);
+        throw;
     }
 
-    std::string pathStr(path.string());
-    std::string pathNoFilename(pathStr.substr(0, pathStr.length() - path.filename().string().length()));
-    /// We store current working directory, so we can return back in the end
-    const std::string currentDir = m_currentDirPath;
+    m_inodeService.saveInode(inode);
+    linkFile(directory, name, inode);
+}
+
+void FileSystem::createFileFromStream(const std::filesystem::path &path, std::istream &stream, const std::size_t size) {
+    auto [directory, name] = lookupNewFile(path);
+    fs::Inode inode(createFileInode(directory, size));
 
-    if (m_currentDirPath != pathNoFilename) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        try {
-            changeDirectory(pathNoFilename);
-        } catch (const std::exception &ex) {
-            throw std::invalid_argument(fnct::PNF_DEST);
+    if (size <= fs::Inode::INLINE_DATA_SIZE) {
+        std::string data(size, '\0');
+        stream.read(data.data(), static_cast<std::streamsize>(size));
+        if (static_cast<std::size_t>(stream.gcount()) != size) {
+            m_inodeService.removeInode(inode);
+            throw std::ios_base::failure("Chyba při čtení importovaného souboru");
         }
+        inode.setInlineData(data);
+        m_inodeService.saveInode(inode);
+        linkFile(directory, name, inode);
+        return;
     }
 
-    std::vector<fs::DirectoryItem> dirItems(m_dataService.getDirectoryItems(m_currentDirInode));
-    auto it = std::find_if(dirItems.begin(), dirItems.end(), [&path](const fs::DirectoryItem item) { return item.nameEquals(path.filename()); });
-    if (it != dirItems.end()) {
-        throw pfs::InvalidState("Soubor s předaným názvem již exituje!");
+    /// Clusters are allocated by the size of the stream, data then passes through a buffer of a few clusters
+    std::size_t clusterCount = (size + fs::Superblock::CLUSTER_SIZE - 1) / fs::Superblock::CLUSTER_SIZE;
+    bool mapped = false;
+    try {
+        if (m_options.fileMapping == pfs::FileMapping::EXTENTS) {
+            std::vector<int32_t> treeBlocks;
+            std::vector<fs::Extent> extents(m_dataService.allocateExtents(clusterCount, inode, treeBlocks));
+            mapped = true;
+            m_dataService.saveFileData(stream, size, extents, treeBlocks, inode);
+        } else {
+            std::vector<int32_t> dataClusterIndexes(
+                    m_dataService.allocateDataBlocks(fs::ClusteredFileData::requiredDataBlocks(clusterCount), inode));
+            inode.setData(fs::DataLinks(dataClusterIndexes));
+            mapped = true;
+            m_dataService.saveFileData(stream, size, dataClusterIndexes);
+        }
+    } catch (const std::exception &ex) {
+        /// The mapping is written before the data, so the clusters of a failed stream are freed through the inode
+        if (mapped) {
+            m_dataService.clearInodeData(inode);
+        }
+        m_inodeService.removeInode(inode);
+        throw;
     }
 
-    fs::Inode inode(m_inodeService.createInode(false, fileData.size()));
+    m_inodeService.saveInode(inode);
+    linkFile(directory, name, inode);
+}
 
-    fs::ClusteredFileData clusteredData(fileData);
-    std::vector<int32_t> dataClusterIndexes(m_dataService.getFreeDataBlocks(clusteredData.requiredDataBlocks()));
-    inode.setData(fs::DataLinks(dataClusterIndexes));
+std::pair<fs::Inode, std::string> FileSystem::lookupNewFile(const std::filesystem::path &path) const {
+    if (!path.has_filename()) {
+        throw std::invalid_argument("Předaná cesta nekončí názvem souboru");
+    }
 
-    m_inodeService.saveInode(inode);
-    m_dataService.saveFileData(clusteredData, dataClusterIndexes);
-    /// We cd'd into the parent folder so we can just save into current folder
-    m_dataService.saveDirItemIntoDirectory(fs::DirectoryItem(path.filename(), inode.getInodeId()), m_currentDirInode);
-    m_currentDirInode.setFileSize(m_currentDirInode.getFileSize() + inode.getFileSize());
-    m_inodeService.saveInode(m_currentDirInode);
+    if (path.filename().string().size() > fs::DirectoryItem::MAX_NAME_LENGTH) {
+        throw std::invalid_argument("Název souboru smí být maximálně 11 znaků dlouhý!");
+    }
+
+    fs::Inode directory;
+    std::string name;
+    try {
+        std::tie(directory, name) = lookupParent(path);
+    } catch (const std::exception &ex) {
+        throw std::invalid_argument(fnct::PNF_DEST);
+    }
 
-    while (m_currentDirPath != "/") {
-        changeDirectory("../");
-        m_currentDirInode.setFileSize(m_currentDirInode.getFileSize() + inode.getFileSize());
-        m_inodeService.saveInode(m_currentDirInode);
+    if (lookupInodeId(name, directory) != fs::FREE_INODE_ID) {
+        throw pfs::InvalidState("Soubor s předaným názvem již exituje!");
     }
 
-    changeDirectory(currentDir);
+    return { directory, name };
+}
+
+fs::Inode FileSystem::createFileInode(const fs::Inode &directory, const std::size_t size) {
+    /// New files are placed into the allocation group of their directory
+    fs::Inode inode(m_inodeService.createInode(false, size, m_superblock.getInodeGroup(directory.getInodeId())));
+    inode.setParentId(directory.getInodeId());
+    return inode;
+}
 
+void FileSystem::linkFile(fs::Inode &directory, const std::string &name, const fs::Inode &inode) {
+    try {
+        /// Saving the item may need a new bucket, the file is removed again if the directory can't hold it
+        m_dataService.saveDirItemIntoDirectory(fs::DirectoryItem(name, inode.getInodeId(), fs::FileType::REGULAR), directory);
+    } catch (const std::exception &ex) {
+        m_dataService.clearInodeData(inode);
+        m_inodeService.removeInode(inode);
+        throw;
+    }
+    m_dentryCache.put(directory.getInodeId(), name, inode.getInodeId());
+    m_inodeService.saveInode(directory);
+    updateDirectorySizes(directory.getInodeId(), inode.getFileSize());
 }
 
 void FileSystem::removeFile(const std::filesystem::path &path) {
@@ -218,36 +386,18 @@ void FileSystem::removeFile(const std::filesystem::path &path) {
         throw std::invalid_argument("Předaná cesta nekončí názvem souboru");
     }
 
-    std::string pathStr(path.string());
-    std::string pathNoFilename = pathStr.substr(0, pathStr.length() - path.filename().string().length());
-    /// We store current working directory, so we can return back in the end
-    const std::string currentDir = m_currentDirPath;
-
-    if (m_currentDirPath != pathNoFilename) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        changeDirectory(pathNoFilename);
-    }
-
-    fs::DirectoryItem directoryItem = m_dataService.findDirectoryItem(path.filename(), m_currentDirInode);
-    fs::Inode fileInode(m_inodeService.findInode(directoryItem.getInodeId()));
+    auto [directory, name] = lookupParent(path);
+    fs::Inode fileInode(m_inodeService.findInode(findInodeId(name, directory)));
     if (fileInode.isDirectory()) {
         throw std::invalid_argument("Soubor na předané cestě nelze smazat, protože je to složka");
     }
 
-    m_dataService.removeDirectoryItem(path.filename(), m_currentDirInode);
+    m_dataService.removeDirectoryItem(name, directory);
+    m_dentryCache.put(directory.getInodeId(), name, fs::FREE_INODE_ID);
     m_dataService.clearInodeData(fileInode);
     m_inodeService.removeInode(fileInode);
 
-    m_currentDirInode.setFileSize(m_currentDirInode.getFileSize() - fileInode.getFileSize());
-    m_inodeService.saveInode(m_currentDirInode);
-
-    while (m_currentDirPath != "/") {
-        changeDirectory("../");
-        m_currentDirInode.setFileSize(m_currentDirInode.getFileSize() - fileInode.getFileSize());
-        m_inodeService.saveInode(m_currentDirInode);
-    }
-
-    changeDirectory(currentDir);
+    updateDirectorySizes(directory.getInodeId(), -fileInode.getFileSize());
 }
 
 void FileSystem::changeDirectory(const std::filesystem::path& path) {
@@ -256,62 +406,123 @@ void FileSystem::changeDirectory(const std::filesystem::path& path) {
         return;
     }
 
-    std::vector<std::string> tokens = pfs::path::parsePath(path);
+    fs::Inode directory = lookup(path);
+    if (!directory.isDirectory()) {
+        throw std::invalid_argument("Soubor v předané cestě není adresář");
+    }
 
-    /// First we need to know from which directory we will move
-    fs::Inode referenceFolder;
-    bool isAbsolute = pfs::path::isAbsolute(path);
-    if (isAbsolute) {
-        m_inodeService.getRootInode(referenceFolder);
+    /// Setting found path as current path
+    m_currentDirInode = directory;
+    if (pfs::path::isAbsolute(path)) {
+        m_currentDirPath = path;
     } else {
-        referenceFolder = m_currentDirInode;
+        m_currentDirPath = pfs::path::createAbsolutePath(m_currentDirPath, path);
     }
+}
 
+pfs::DirectoryCursor FileSystem::openDirectory(const std::filesystem::path &dirPath, const pfs::DirectoryPosition position) {
+    return pfs::DirectoryCursor(m_dataService, lookup(dirPath), position);
+}
+
+int32_t FileSystem::lookupInodeId(const std::string &name, const fs::Inode &directory) const {
+    if (const int32_t* cached = m_dentryCache.find(directory.getInodeId(), name)) {
+        return *cached;
+    }
 
-    std::vector<fs::DirectoryItem> directoryItems;
-    /// Now we can iterate through every passed file name
-    for (const auto &name : tokens) {
+    int32_t inodeId = fs::FREE_INODE_ID;
+    try {
+        inodeId = m_dataService.findDirectoryItem(name, directory).getInodeId();
+    } catch (const pfs::ObjectNotFound &ex) {
+        /// Missing name is cached as well, lookups of files about to be created are repeated often
+    }
+    m_dentryCache.put(directory.getInodeId(), name, inodeId);
+    return inodeId;
+}
+
+int32_t FileSystem::findInodeId(const std::string &name, const fs::Inode &directory) const {
+    int32_t inodeId = lookupInodeId(name, directory);
+    if (inodeId == fs::FREE_INODE_ID) {
+        throw pfs::ObjectNotFound("Directory item s předaným názvem nenalezen!");
+    }
+    return inodeId;
+}
+
+fs::Inode FileSystem::lookup(const std::filesystem::path &path) const {
+    fs::Inode inode;
+    if (pfs::path::isAbsolute(path)) {
+        m_inodeService.getRootInode(inode);
+    } else {
+        /// Working directory may have been changed since it was entered, so it's i-node is taken again
+        inode = m_inodeService.findInode(m_currentDirInode.getInodeId());
+    }
+
+    for (const auto &name : pfs::path::parsePath(path)) {
         if (name.empty()) {
             continue;
         }
+        if (!inode.isDirectory()) {
+            throw std::invalid_argument("Soubor v předané cestě není adresář");
+        }
 
-        directoryItems = m_dataService.getDirectoryItems(referenceFolder);
-        auto it = std::find_if(directoryItems.begin(), directoryItems.end(), [&name](const fs::DirectoryItem item) { return item.nameEquals(name); });
-        if (it == directoryItems.end()) {
+        int32_t inodeId = lookupInodeId(name, inode);
+        if (inodeId == fs::FREE_INODE_ID) {
             throw std::invalid_argument("Předaná cesta neexistuje");
         }
+        inode = m_inodeService.findInode(inodeId);
+    }
 
-        fs::Inode dirItemInode = m_inodeService.findInode(it.base()->getInodeId());
-        if (!dirItemInode.isDirectory()) {
-            throw std::invalid_argument("Soubor v předané cestě není adresář");
-        }
+    return inode;
+}
 
-        referenceFolder = dirItemInode;
+std::pair<fs::Inode, std::string> FileSystem::lookupParent(const std::filesystem::path &path) const {
+    /// Path of a directory may end with a slash, then the last name is in front of it
+    const std::filesystem::path itemPath = path.has_filename() ? path : path.parent_path();
+    const std::string name = itemPath.filename();
+    if (name.empty()) {
+        throw std::invalid_argument("Předaná cesta nekončí názvem souboru");
     }
 
-    /// Setting found path as current path
-    m_currentDirInode = referenceFolder;
-    if (isAbsolute) {
-        m_currentDirPath = path;
-    } else {
-        m_currentDirPath = pfs::path::createAbsolutePath(m_currentDirPath, path);
+    fs::Inode parent = lookup(itemPath.parent_path());
+    if (!parent.isDirectory()) {
+        throw std::invalid_argument("Soubor v předané cestě není adresář");
     }
+    return { parent, name };
 }
 
-std::vector<fs::DirectoryItem> FileSystem::getDirectoryItems(const std::filesystem::path &dirPath) {
-    const fs::Inode currentDirInode = m_currentDirInode;
-    const std::string currentDirPath = m_currentDirPath;
+void FileSystem::updateDirectorySizes(const int32_t directoryId, const int64_t sizeDelta) {
+    m_directorySizeDeltas[directoryId] += sizeDelta;
+}
 
-    if (m_currentDirPath != dirPath) {
-        changeDirectory(dirPath);
+void FileSystem::applyDirectorySizes() {
+    if (m_directorySizeDeltas.empty()) {
+        return;
     }
 
-    std::vector<fs::DirectoryItem> dirItems = m_dataService.getDirectoryItems(m_currentDirInode);
+    /// Changes are summed up for every ancestor first, so each of them is saved once
+    std::map<int32_t, int64_t> sizeDeltas;
+    for (const auto &[directoryId, sizeDelta] : m_directorySizeDeltas) {
+        if (sizeDelta == 0) {
+            continue;
+        }
 
-    m_currentDirInode = currentDirInode;
-    m_currentDirPath = currentDirPath;
+        int32_t inodeId = directoryId;
+        while (true) {
+            sizeDeltas[inodeId] += sizeDelta;
+            int32_t parentId = m_inodeService.findInode(inodeId).getParentId();
+            if (parentId == inodeId) {
+                /// Root is it's own parent
+                break;
+            }
+            inodeId = parentId;
+        }
+    }
+    m_directorySizeDeltas.clear();
 
-    return dirItems;
+    for (const auto &[inodeId, sizeDelta] : sizeDeltas) {
+        fs::Inode directory = m_inodeService.findInode(inodeId);
+        directory.setFileSize(directory.getFileSize() + sizeDelta);
+        m_inodeService.saveInode(directory);
+    }
 }
 
 fs::Inode FileSystem::findInode(const int inodeId) {
@@ -324,30 +535,13 @@ void FileSystem::printFileContent(const std::filesystem::path &pathToFile) {
         throw std::invalid_argument("Předaná cesta nemá název souboru!");
     }
 
-    std::string pathStr(pathToFile.string());
-    std::string pathNoFilename(pathStr.substr(0, pathStr.length() - pathToFile.filename().string().length()));
-    /// We store current working directory, so we can return back in the end
-    const std::string currentDir = m_currentDirPath;
-    const fs::Inode currentInode = m_currentDirInode;
-
-    if (m_currentDirPath != pathNoFilename) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        changeDirectory(pathNoFilename);
-    }
-
-    fs::DirectoryItem dirItem = m_dataService.findDirectoryItem(pathToFile.filename(), m_currentDirInode);
-    fs::Inode inode = m_inodeService.findInode(dirItem.getInodeId());
+    fs::Inode inode = lookup(pathToFile);
     if (inode.isDirectory()) {
         throw std::invalid_argument("Obsah adresáře nelze vypsat! Použijte funkci \"ls\"!");
     }
 
     std::string fileContent = m_dataService.getFileContent(inode);
     std::cout << fileContent << '\n';
-
-    if (currentDir != pathNoFilename) {
-        m_currentDirPath = currentDir;
-        m_currentDirInode = currentInode;
-    }
 }
 
 std::string FileSystem::getFileContent(const std::filesystem::path &pathToFile) {
@@ -355,76 +549,70 @@ std::string FileSystem::getFileContent(const std::filesystem::path &pathToFile)
         throw std::invalid_argument("Předaná cesta nemá název souboru!");
     }
 
-    std::string pathStr(pathToFile.string());
-    std::string pathNoFilename(pathStr.substr(0, pathStr.length() - pathToFile.filename().string().length()));
-    /// We store current working directory, so we can return back in the end
-    const std::string currentDir = m_currentDirPath;
-    const fs::Inode currentInode = m_currentDirInode;
-
-    if (m_currentDirPath != pathNoFilename) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        changeDirectory(pathNoFilename);
-    }
-    fs::DirectoryItem dirItem = m_dataService.findDirectoryItem(pathToFile.filename(), m_currentDirInode);
-    fs::Inode inode = m_inodeService.findInode(dirItem.getInodeId());
+    fs::Inode inode = lookup(pathToFile);
     if (inode.isDirectory()) {
         throw pfs::InvalidState("Obsah adresáře nelze vrátit! Použijte funkci \"ls\"!");
     }
 
-    std::string fileContent = m_dataService.getFileContent(inode);
-
-    if (currentDir != pathNoFilename) {
-        m_currentDirPath = currentDir;
-        m_currentDirInode = currentInode;
-    }
-
-    return fileContent;
+    return m_dataService.getFileContent(inode);
 }
 
 void FileSystem::printFileInfo(const std::filesystem::path &pathToFile) {
-    std::filesystem::path parentPath(pathToFile.parent_path());
-
-    const std::string currentDir = m_currentDirPath;
-    const fs::Inode currentInode = m_currentDirInode;
-
-    if (m_currentDirPath != parentPath && !parentPath.empty()) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        changeDirectory(parentPath);
-    }
+    /// Sizes of directories are up to date only after the recorded changes are applied
+    applyDirectorySizes();
 
+    fs::Inode inode;
     std::string filename;
-    if (pathToFile.has_filename()) {
-        filename = pathToFile.filename();
-    } else {
-        filename = std::filesystem::path(m_currentDirPath).filename();
+    try {
+        if (pathToFile.relative_path().empty()) {
+            /// Root has no name in a parent directory, it's i-node is resolved directly
+            inode = lookup(pathToFile);
+        } else {
+            fs::Inode directory;
+            std::tie(directory, filename) = lookupParent(pathToFile);
+            inode = m_inodeService.findInode(findInodeId(filename, directory));
+        }
+    } catch (const std::invalid_argument &ex) {
+        throw pfs::ObjectNotFound("Předaná cesta neexistuje");
     }
 
-    fs::DirectoryItem dirItem = m_dataService.findDirectoryItem(filename, m_currentDirInode);
-    fs::Inode inode = m_inodeService.findInode(dirItem.getInodeId());
-
-    std::cout << "Name: " << dirItem.getItemName().data() << " - Size: " << inode.getFileSize() << " - Inode ID: " << inode.getInodeId() << " - ";
-    std::cout << "Direct links: ";
-    for (const auto &link : inode.getDirectLinks()) {
-        if (link == fs::EMPTY_LINK) {
-            break;
+    std::cout << "Name: " << filename << " - Size: " << inode.getFileSize() << " - Inode ID: " << inode.getInodeId() << " - ";
+    if (inode.hasInlineData()) {
+        std::cout << "Inline data ";
+    } else if (inode.usesExtents()) {
+        std::cout << "Extents: ";
+        for (const auto &extent : m_dataService.getDataExtents(inode)) {
+            std::cout << extent.start << "+" << extent.length << " ";
+        }
+        if (inode.getExtentTreeLink() != fs::EMPTY_LINK) {
+            std::cout << "Extent tree: " << inode.getExtentTreeLink() << " ";
         }
+    } else {
+        std::cout << "Direct links: ";
+        for (const auto &link : inode.getDirectLinks()) {
+            if (link == fs::EMPTY_LINK) {
+                break;
+            }
 
-        std::cout << link << " ";
-    }
-    std::cout << "Indirect links: ";
-    for (const auto &link: inode.getIndirectLinks()) {
-        if (link == fs::EMPTY_LINK) {
-            break;
+            std::cout << link << " ";
         }
+        std::cout << "Indirect links: ";
+        for (const auto &link: inode.getIndirectLinks()) {
+            if (link == fs::EMPTY_LINK) {
+                break;
+            }
 
-        std::cout << link << " ";
+            std::cout << link << " ";
+        }
+        if (inode.getDoubleIndirectLink() != fs::EMPTY_LINK) {
+            std::cout << "Double indirect link: " << inode.getDoubleIndirectLink() << " ";
+        }
+        if (inode.getTripleIndirectLink() != fs::EMPTY_LINK) {
+            std::cout << "Triple indirect link: " << inode.getTripleIndirectLink() << " ";
+        }
     }
+    std::cout << "- Fragments: " << m_dataService.getFragmentCount(inode);
     std::cout << std::endl;
-
-    if (currentDir != parentPath && !parentPath.empty()) {
-        m_currentDirPath = currentDir;
-        m_currentDirInode = currentInode;
-    }
 }
 
 void FileSystem::createDirectory(const std::filesystem::path &path) {
@@ -432,51 +620,45 @@ void FileSystem::createDirectory(const std::filesystem::path &path) {
         throw std::invalid_argument("Path must not be empty!");
     }
 
-    std::filesystem::path directory;
-    std::filesystem::path parent;
-    if (path.has_filename()) {
-        directory = path.filename();
-        parent = path.parent_path();
-    } else {
-        directory = path.parent_path().filename();
-        parent = path.parent_path().parent_path();
+    fs::Inode parent;
+    std::string name;
+    try {
+        std::tie(parent, name) = lookupParent(path);
+    } catch (const std::exception& ex) {
+        throw std::invalid_argument(fnct::PNF_DEST);
     }
 
-
-    const std::string currentDir = m_currentDirPath;
-    const fs::Inode currentInode = m_currentDirInode;
-
-    if (m_currentDirPath != parent && !parent.empty()) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        try {
-            changeDirectory(parent);
-        } catch (const std::exception& ex) {
-            throw std::invalid_argument(fnct::PNF_DEST);
-        }
+    if (name.size() > fs::DirectoryItem::MAX_NAME_LENGTH) {
+        throw std::invalid_argument("Název adresáře smí být maximálně 11 znaků dlouhý!");
     }
-
-    std::vector<fs::DirectoryItem> dirItems(m_dataService.getDirectoryItems(m_currentDirInode));
-    auto it = std::find_if(dirItems.begin(), dirItems.end(), [&directory](const fs::DirectoryItem item) { return item.nameEquals(directory.filename()); });
-    if (it != dirItems.end()) {
+    if (lookupInodeId(name, parent) != fs::FREE_INODE_ID) {
         throw pfs::InvalidState(fnct::EXISTS);
     }
 
-    fs::Inode inode(m_inodeService.createInode(true, 0));
-    fs::DirectoryItem directoryItem(directory.string(), inode.getInodeId());
-    m_dataService.saveDirItemIntoDirectory(directoryItem, m_currentDirInode);
-    m_inodeService.saveInode(inode);
-    m_inodeService.saveInode(m_currentDirInode);
-
-    fs::DirectoryItem dirItemSelf(".", inode.getInodeId());
-    fs::DirectoryItem dirItemParent("..", m_currentDirInode.getInodeId());
-
-    changeDirectory(directory);
-    m_dataService.saveDirItemIntoDirectory(dirItemSelf, m_currentDirInode);
-    m_dataService.saveDirItemIntoDirectory(dirItemParent, m_currentDirInode);
-    m_inodeService.saveInode(m_currentDirInode);
+    /// New directories are spread into the allocation group with the most free space, their files will follow them.
+    /// The data group is mapped onto the i-node groups proportionally, the i-node bitmap may have fewer groups
+    std::size_t inodeGroup = m_dataService.findEmptiestGroup() * m_superblock.getInodeGroupCount() / m_superblock.getGroupCount();
+    fs::Inode inode(m_inodeService.createInode(true, 0, inodeGroup));
+    inode.setParentId(parent.getInodeId());
+    try {
+        /// Items "." and ".." are written together with the empty index into the first cluster of the directory
+        m_dataService.initializeDirectory(inode, parent.getInodeId());
+    } catch (const std::exception &ex) {
+        m_inodeService.removeInode(inode);
+        throw;
+    }
 
-    /// Returning back to the original directory
-    changeDirectory(currentDir);
+    fs::DirectoryItem directoryItem(name, inode.getInodeId(), fs::FileType::DIRECTORY);
+    try {
+        m_dataService.saveDirItemIntoDirectory(directoryItem, parent);
+    } catch (const std::exception &ex) {
+        m_dataService.clearInodeData(inode);
+        m_inodeService.removeInode(inode);
+        throw;
+    }
+    m_dentryCache.put(parent.getInodeId(), name, inode.getInodeId());
+    m_inodeService.saveInode(inode);
+    m_inodeService.saveInode(parent);
 }
 
 void FileSystem::removeDirectory(const std::filesystem::path &path) {
@@ -484,59 +666,37 @@ void FileSystem::removeDirectory(const std::filesystem::path &path) {
         throw std::invalid_argument("Path must not be empty!");
     }
 
-    std::filesystem::path directory;
-    std::filesystem::path parent;
-    if (path.has_filename()) {
-        directory = path.filename();
-        parent = path.parent_path();
-    } else {
-        directory = path.parent_path().filename();
-        parent = path.parent_path().parent_path();
-    }
-
-    const std::string currentDir = m_currentDirPath;
-    const fs::Inode currentInode = m_currentDirInode;
-
-    if (m_currentDirPath != parent && !parent.empty()) {
-        /// By changing to given path we not only get access to the i-node we need, but also validate it's existence
-        try {
-            changeDirectory(parent);
-        } catch (const std::exception &ex) {
-            throw std::invalid_argument(fnct::FNF_DIR);
-        }
+    fs::Inode parent;
+    std::string name;
+    try {
+        std::tie(parent, name) = lookupParent(path);
+    } catch (const std::exception &ex) {
+        throw std::invalid_argument(fnct::FNF_DIR);
     }
 
-    fs::DirectoryItem dirItem = m_dataService.findDirectoryItem(directory, m_currentDirInode);
-    fs::Inode inode = m_inodeService.findInode(dirItem.getInodeId());
+    fs::Inode inode = m_inodeService.findInode(findInodeId(name, parent));
     if (!inode.isDirectory()) {
         throw std::invalid_argument(fnct::FNF_DIR);
     }
 
-    for (int i = 1; i < inode.getDirectLinks().size(); ++i) {
-        if (inode.getDirectLinks()[i] != fs::EMPTY_LINK) {
-            throw pfs::InvalidState(fnct::NOT_EMPTY);
-        }
-    }
-
-    for (const auto& indirectLink : inode.getIndirectLinks()) {
-        if (indirectLink != fs::EMPTY_LINK) {
-            throw pfs::InvalidState(fnct::NOT_EMPTY);
-        }
-    }
-
-    if (m_dataService.getFreeDirItemDataBlockSubindex(inode.getDirectLinks()[0]) != 2 * sizeof(dirItem)) {
+    /// Emptied buckets stay allocated, so the emptiness is given by the item count in the index header
+    if (m_dataService.getDirectoryItemCount(inode) != 0) {
         throw pfs::InvalidState(fnct::NOT_EMPTY);
     }
 
-    m_dataService.removeDirectoryItem(directory.string(), m_currentDirInode);
+    m_dataService.removeDirectoryItem(name, parent);
+    /// Entries of the removed directory are dropped as well, it's i-node ID may be given to a new directory
+    m_dentryCache.put(parent.getInodeId(), name, fs::FREE_INODE_ID);
+    m_dentryCache.eraseDirectory(inode.getInodeId());
+    /// Recorded size change of the removed directory still has to be added to it's ancestors
+    auto sizeDelta = m_directorySizeDeltas.find(inode.getInodeId());
+    if (sizeDelta != m_directorySizeDeltas.end()) {
+        int64_t removedDelta = sizeDelta->second;
+        m_directorySizeDeltas.erase(sizeDelta);
+        updateDirectorySizes(parent.getInodeId(), removedDelta);
+    }
     m_dataService.clearInodeData(inode);
     m_inodeService.removeInode(inode);
-
-    if (m_currentDirPath != parent && !parent.empty()) {
-        /// Returning back to the original directory
-        m_currentDirInode = currentInode;
-        m_currentDirPath = currentDir;
-    }
 }
 
 void FileSystem::copyFile(const std::filesystem::path &pathFrom, const std::filesystem::path &pathTo) {
@@ -563,6 +723,7 @@ void FileSystem::moveFile(const std::filesystem::path &pathFrom, const std::file
         throw std::invalid_argument("Paths must not be empty!");
     }
 
+    /// Dentries of both paths are updated by the creation and the removal of the file
     copyFile(pathFrom, pathTo);
     removeFile(pathFrom);
 }
@@ -581,7 +742,7 @@ void FileSystem::checkData() {
         }
         if (!inode.isDirectory()) {
             content = m_dataService.getFileContent(inode);
-            if (content.length() != inode.getFileSize()) {
+            if (content.length() != static_cast<std::size_t>(inode.getFileSize())) {
                 std::cout << "Velikost souboru v I-uzlu " << inode.getInodeId() << " (" << inode.getFileSize()
                           << ") neodpovídá velikosti uložených dat (" << content.length() << ")!\n";
             }
@@ -600,6 +761,10 @@ void FileSystem::checkData() {
         for (auto &dirItem : directoryItems) {
             if (dirItem.getInodeId() == inode.getInodeId() && (!dirItem.nameEquals(".") && !dirItem.nameEquals(".."))) {
                 isInDirectory = true;
+                if (dirItem.isDirectory() != inode.isDirectory()) {
+                    std::cout << "Typ položky " << dirItem.getItemName().data() << " neodpovídá typu I-uzlu s ID: "
+                              << inode.getInodeId() << "!\n";
+                }
                 break;
             }
         }
@@ -622,6 +787,9 @@ void FileSystem::breakData() {
             fs::Inode inode = m_inodeService.findInode(dirItem.getInodeId());
             inode.setData(fs::DataLinks(std::vector<int32_t>()));
             m_inodeService.saveInode(inode);
+            /// Removed items and the items of the emptied directories must not be resolved from the cache anymore
+            m_dentryCache.put(root.getInodeId(), dirItem.getItemName().data(), fs::FREE_INODE_ID);
+            m_dentryCache.eraseDirectory(inode.getInodeId());
         }
     }
 }
@@ -10,11 +10,18 @@
 #include <iostream>
 #include <filesystem>
 #include <vector>
+#include <utility>
+#include <unordered_map>
 
 #include "../common/structures.h"
 #include "FileData.h"
 #include "InodeService.h"
 #include "DataService.h"
+#include "BlockDevice.h"
+#include "MountOptions.h"
+#include "BufferCache.h"
+#include "DentryCache.h"
+#include "DirectoryCursor.h"
 
 /**
  * Represents the virtual file system loaded by the application. File system is represented by one file where
@@ -27,9 +34,15 @@ private: //private attributes
     std::string m_dataFileName;
     /// Is file system initialized?
     bool m_initialized = false;
+    /// Options the file system is mounted with
+    pfs::MountOptions m_options;
+    /// Device holding the data file opened for the whole time the file system is mounted
+    std::shared_ptr<pfs::BlockDevice> m_device;
+    /// Buffer cache on top of the device, null if caching is disabled
+    std::shared_ptr<pfs::BufferCache> m_cache;
     /// Superblock with fundamental information about the file system.
     fs::Superblock m_superblock{};
-    /// Inode of current working directory. Used for easier orientation.
+    /// Inode of current working directory, relative paths are resolved from it. Only it's ID is used by the lookups.
     fs::Inode m_currentDirInode;
     /// Current working directory
     std::string m_currentDirPath;
@@ -37,14 +50,19 @@ private: //private attributes
     pfs::InodeService m_inodeService;
     /// Service for manipulation with inode data
     pfs::DataService m_dataService;
+    /// Directory items resolved by the path lookups
+    pfs::DentryCache m_dentryCache;
+    /// Size changes of directories by their i-node IDs, not added to the directories and their ancestors yet
+    std::unordered_map<int32_t, int64_t> m_directorySizeDeltas;
 public: //public methods
     /**
      * Default constructor for initialization.
      *
      * @param fileName data-file name
+     * @param options options to mount the file system with
      */
-    explicit FileSystem(const std::string& fileName)
-        : m_dataFileName(fileName) {
+    explicit FileSystem(const std::string& fileName, const pfs::MountOptions& options = pfs::MountOptions())
+        : m_dataFileName(fileName), m_options(options) {
         if (std::filesystem::exists(fileName)) {
             try {
                 initializeFromExisting();
@@ -57,6 +75,11 @@ public: //public methods
     }
 
 
+    /**
+     * Writes all the cached data back into the data file.
+     */
+    ~FileSystem();
+
     /**
      * Initializes the file system in data file. Writes super-block, bitmaps, and root directory inside.
      *
@@ -90,6 +113,17 @@ public: //public methods
      */
     void createFile(const std::filesystem::path& path, const fs::FileData& data);
 
+    /**
+     * Creates file in virtual file system on given path with the data read from given stream. The data is never
+     * held in the memory whole, it's written cluster by cluster as it's read, so files of any size may be imported.
+     *
+     * @param path path in virtual file system
+     * @param stream stream to read the data of the file from
+     * @param size number of bytes to read from the stream
+     * @throw ios_base::failure if the stream ends before @a size bytes are read
+     */
+    void createFileFromStream(const std::filesystem::path& path, std::istream& stream, std::size_t size);
+
     /**
      * Removes file at the end of the given path in virtual file system.
      *
@@ -113,6 +147,24 @@ public: //public methods
      * @throw std::invalid_argument If there is any error
      */
     void changeDirectory(const std::filesystem::path& path);
+    /**
+     * Resolves given path into the i-node at it's end. Relative path is resolved from the current working directory,
+     * which is left unchanged.
+     *
+     * @param path absolute or relative path to resolve
+     * @return i-node of the file or directory at the end of the path
+     * @throw std::invalid_argument if the path doesn't exist
+     */
+    [[nodiscard]] fs::Inode lookup(const std::filesystem::path& path) const;
+    /**
+     * Resolves the directory containing the last item of given path. The item itself doesn't have to exist.
+     * A trailing slash is ignored, so "a/b/" gives directory "a" and name "b".
+     *
+     * @param path absolute or relative path to resolve
+     * @return i-node of the parent directory and the name of the last item of the path
+     * @throw std::invalid_argument if the parent directory doesn't exist or the path has no name in the end
+     */
+    [[nodiscard]] std::pair<fs::Inode, std::string> lookupParent(const std::filesystem::path& path) const;
     /**
      * Returns the inode with given id. If inode with given doesn't exist, throws an exception.
      *
@@ -121,13 +173,16 @@ public: //public methods
      */
     fs::Inode findInode(int inodeId);
     /**
-     * Returns all directory items of directory on given path in a virtual filesystem.
+     * Opens a cursor listing the items of directory on given path in a virtual filesystem. Every item carries it's name,
+     * i-node ID and file type, so the directory is listed by reading only it's own clusters, one at a time.
+     * The cursor is valid while the file system stays mounted.
      *
      * @param dirPath directory path in the virtual file system
-     * @return vector of directory items
+     * @param position position to start the listing at, the first item by default
+     * @return cursor at given position of the directory
      * @throw invalid_argument if the path doesn't exist or doesn't point to a directory
      */
-    std::vector<fs::DirectoryItem> getDirectoryItems(const std::filesystem::path& dirPath);
+    pfs::DirectoryCursor openDirectory(const std::filesystem::path& dirPath, pfs::DirectoryPosition position = {});
     /**
      * Prints content of a file into the console.
      *
@@ -184,50 +239,134 @@ public: //public methods
      * Breaks data consistence to demonstrate checkData method functionality.
      */
     void breakData();
+    /**
+     * Adds recorded size changes to the directories and saves changed parts of the bitmaps. Until then the sizes
+     * of directories and the bitmaps are changed only in the memory.
+     */
+    void flush();
+    /**
+     * Saves changed parts of the bitmaps, writes all the cached data back into the data file and forces them to the storage.
+     */
+    void sync();
+    /**
+     * Prints statistics of the buffer cache into the console.
+     */
+    void printCacheStatistics() const;
+    /**
+     * Prints statistics of the i-node cache into the console.
+     */
+    void printInodeCacheStatistics() const;
+    /**
+     * Prints statistics of the dentry cache into the console.
+     */
+    void printDentryCacheStatistics() const;
 private: //private methods
     /**
-     * Writes superblock at the start of the file-system. Requires open input stream to data file passed. If
-     * the input stream is closed, returns a failure.
+     * Resolves the directory where a new file with given path is created, checking that the name is valid
+     * and not used yet.
+     *
+     * @param path path of the new file
+     * @return i-node of the parent directory and the name of the new file
+     * @throw std::invalid_argument if the path has no valid name or the parent directory doesn't exist
+     * @throw InvalidState if the directory already contains an item with the name
+     */
+    [[nodiscard]] std::pair<fs::Inode, std::string> lookupNewFile(const std::filesystem::path& path) const;
+    /**
+     * Creates the i-node of a new file of given size in given directory. The i-node is placed into the allocation
+     * group of the directory, it's data is not mapped yet.
+     *
+     * @param directory parent directory of the file
+     * @param size size of the file in bytes
+     * @return created i-node
+     */
+    fs::Inode createFileInode(const fs::Inode& directory, std::size_t size);
+    /**
+     * Saves the item of given new file into given directory and records the size change of the directory.
+     * If the item can't be saved, the file is removed with it's data.
+     *
+     * @param directory parent directory of the file, saved as it may get new clusters
+     * @param name name of the file
+     * @param inode i-node of the file
+     */
+    void linkFile(fs::Inode& directory, const std::string& name, const fs::Inode& inode);
+    /**
+     * Returns the i-node ID of the item with given name in given directory. Results, including missing names,
+     * are kept in the dentry cache, so repeated lookups don't read the directory again.
+     *
+     * @param name name of the item
+     * @param directory directory where to look
+     * @return i-node ID of the item or fs::FREE_INODE_ID if the directory has no item with given name
+     */
+    [[nodiscard]] int32_t lookupInodeId(const std::string& name, const fs::Inode& directory) const;
+    /**
+     * Finds the i-node ID of the item with given name in given directory using the dentry cache.
+     *
+     * @param name name of the item
+     * @param directory directory where to look
+     * @return i-node ID of the item
+     * @throw ObjectNotFound if the directory has no item with given name
+     */
+    [[nodiscard]] int32_t findInodeId(const std::string& name, const fs::Inode& directory) const;
+    /**
+     * Records given size change of given directory. The change is added to the directory and all the directories
+     * above it, up to the root, only by @a applyDirectorySizes, so many changes in a deep tree save every ancestor once.
+     *
+     * @param directoryId i-node ID of the directory whose item was created or removed
+     * @param sizeDelta change of the size in bytes
+     */
+    void updateDirectorySizes(int32_t directoryId, int64_t sizeDelta);
+    /**
+     * Adds all recorded size changes to the sizes of the directories and their ancestors, following their parent IDs,
+     * and saves the changed i-nodes.
+     */
+    void applyDirectorySizes();
+    /**
+     * Opens the device holding the data file and puts the buffer cache on top of it, if enabled.
+     *
+     * @param truncate should the data file be created or truncated?
+     * @param size size of the truncated data file
+     * @return true if the device was opened, otherwise false
+     */
+    bool openDevice(bool truncate, std::size_t size = 0);
+    /**
+     * Releases the device and all the services using it. All cached data are written back.
+     */
+    void closeDevice();
+    /**
+     * Writes superblock at the start of the file-system. Requires the device to be opened.
      *
-     * @param dataFile open output file stream
      * @param superblock superblock to write
      * @return true when successfully written superblock, otherwise false
      */
-    bool writeSuperblock(std::fstream& dataFile, fs::Superblock& superblock);
+    bool writeSuperblock(fs::Superblock& superblock);
     /**
      * Initializes and writes bitmap of inodes into the file-system. Bitmap corresponds to a filesystem with
-     * root folder only. Requires open output stream to data file passed. If the output stream is closed,
-     * returns a failure.
+     * root folder only. Requires the device to be opened.
      *
-     * @param dataFile open output file stream
      * @return true when successfully written bitmap, otherwise false
      */
-    bool initializeInodeBitmap(std::fstream& dataFile);
+    bool initializeInodeBitmap();
     /**
-     * Initializes inode bitmap from existing data file and loads it into memory. Requires open input stream from existing
-     * data file passed. If the input stream is closed, returns a failure. If the reading process fails, throws an exception.
+     * Initializes inode bitmap from existing data file and loads it into memory. Requires the device to be opened.
+     * If the reading process fails, throws an exception.
      *
-     * @param dataFile open input file stream
      * @return true when successfully read inode bitmap, otherwise false
      */
-    bool initializeInodeBitmap(std::ifstream& dataFile);
+    bool loadInodeBitmap();
     /**
      * Initializes and writes bitmap of data into the file-system. Bitmap corresponds to a filesystem with
-     * root folder only. Requires open output stream to data file passed. If the output stream is closed,
-     * returns a failure.
+     * root folder only. Requires the device to be opened.
      *
-     * @param dataFile open output file stream
      * @return true when successfully written bitmap, otherwise false
      */
-    bool initializeDataBitmap(std::fstream& dataFile);
+    bool initializeDataBitmap();
     /**
-     * Initializes data bitmap from existing data file and loads it into memory. Requires open input stream from existing
-     * data file passed. If the input stream is closed, returns a failure. If the reading process fails, throws an exception.
+     * Initializes data bitmap from existing data file and loads it into memory. Requires the device to be opened.
+     * If the reading process fails, throws an exception.
      *
-     * @param dataFile open input file stream
      * @return true when successfully read data bitmap, otherwise false
      */
-    bool initializeDataBitmap(std::ifstream& dataFile);
+    bool loadDataBitmap();
 };
 
 
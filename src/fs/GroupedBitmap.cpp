@@ -0,0 +1,272 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <algorithm>
+#include "GroupedBitmap.h"
+#include "BlockDevice.h"
+
+pfs::GroupedBitmap::GroupedBitmap(const std::size_t length, const std::size_t indexesPerGroup,
+                                  const std::size_t indexCount)
+                                  : m_indexesPerGroup(indexesPerGroup), m_indexCount(indexCount) {
+    std::size_t groupLength = indexesPerGroup / 8;
+    for (std::size_t offset = 0; offset < length; offset += groupLength) {
+        m_groups.emplace_back(std::min(groupLength, length - offset));
+        m_locks.push_back(std::make_unique<std::mutex>());
+    }
+}
+
+std::size_t pfs::GroupedBitmap::getIndexCount() const {
+    return m_indexCount;
+}
+
+std::size_t pfs::GroupedBitmap::getGroupCount() const {
+    return m_groups.size();
+}
+
+std::size_t pfs::GroupedBitmap::getGroup(const std::size_t index) const {
+    return index / m_indexesPerGroup;
+}
+
+std::size_t pfs::GroupedBitmap::getFreeCount() const {
+    std::size_t freeCount = 0;
+    for (std::size_t group = 0; group < m_groups.size(); ++group) {
+        freeCount += getFreeCount(group);
+    }
+    return freeCount;
+}
+
+std::size_t pfs::GroupedBitmap::getFreeCount(const std::size_t group) const {
+    std::lock_guard<std::mutex> lock(*m_locks.at(group));
+    return m_groups[group].getFreeCount();
+}
+
+std::size_t pfs::GroupedBitmap::findEmptiestGroup() const {
+    std::size_t emptiest = 0;
+    std::size_t mostFree = 0;
+    for (std::size_t group = 0; group < m_groups.size(); ++group) {
+        std::size_t freeCount = getFreeCount(group);
+        if (freeCount > mostFree) {
+            emptiest = group;
+            mostFree = freeCount;
+        }
+    }
+    return emptiest;
+}
+
+bool pfs::GroupedBitmap::isDirty() const {
+    for (std::size_t group = 0; group < m_groups.size(); ++group) {
+        std::lock_guard<std::mutex> lock(*m_locks[group]);
+        if (m_groups[group].isDirty()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void pfs::GroupedBitmap::save(pfs::BlockDevice &device, const std::size_t address) {
+    for (std::size_t group = 0; group < m_groups.size(); ++group) {
+        std::lock_guard<std::mutex> lock(*m_locks[group]);
+        if (m_groups[group].isDirty()) {
+            m_groups[group].save(device, address + getGroupOffset(group));
+        }
+    }
+}
+
+void pfs::GroupedBitmap::load(const pfs::BlockDevice &device, const std::size_t address) {
+    for (std::size_t group = 0; group < m_groups.size(); ++group) {
+        std::lock_guard<std::mutex> lock(*m_locks[group]);
+        m_groups[group].load(device, address + getGroupOffset(group));
+    }
+}
+
+bool pfs::GroupedBitmap::isIndexFilled(const std::size_t index) const {
+    std::size_t group = getGroup(index);
+    if (group >= m_groups.size()) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(*m_locks[group]);
+    return m_groups[group].isIndexFilled(index - (group * m_indexesPerGroup));
+}
+
+void pfs::GroupedBitmap::setIndexFilled(const std::size_t index) {
+    std::size_t group = getGroup(index);
+    if (group >= m_groups.size()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(*m_locks[group]);
+    m_groups[group].setIndexFilled(index - (group * m_indexesPerGroup));
+}
+
+void pfs::GroupedBitmap::setIndexFree(const std::size_t index) {
+    std::size_t group = getGroup(index);
+    if (group >= m_groups.size()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(*m_locks[group]);
+    m_groups[group].setIndexFree(index - (group * m_indexesPerGroup));
+}
+
+int32_t pfs::GroupedBitmap::allocateIndex(const std::size_t preferredGroup) {
+    for (std::size_t i = 0; i < m_groups.size(); ++i) {
+        std::size_t group = (preferredGroup + i) % m_groups.size();
+        std::lock_guard<std::mutex> lock(*m_locks[group]);
+        if (m_groups[group].getFreeCount() == 0) {
+            continue;
+        }
+
+        std::size_t index = m_groups[group].findFirstFreeIndex();
+        if ((group * m_indexesPerGroup) + index < m_indexCount) {
+            m_groups[group].setIndexFilled(index);
+            return (group * m_indexesPerGroup) + index;
+        }
+    }
+
+    throw pfs::ObjectNotFound("Nenalezen žádný volný index v bitmapě");
+}
+
+std::vector<pfs::GroupedBitmap::Run> pfs::GroupedBitmap::allocateRuns(const std::size_t count,
+                                                                      const std::size_t preferredGroup) {
+    if (count == 0 || m_groups.empty()) {
+        throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných indexů bitmapy");
+    }
+
+    /// Smallest run in front of given end the count fits into
+    auto findBestFit = [](std::vector<Run>& runs, std::size_t count) {
+        auto bestFit = runs.end();
+        for (auto it = runs.begin(); it != runs.end(); ++it) {
+            if (it->second >= count && (bestFit == runs.end() || it->second < bestFit->second)) {
+                bestFit = it;
+            }
+        }
+        return bestFit;
+    };
+
+    {
+        /// First only the preferred group is locked
+        std::size_t group = std::min(preferredGroup, m_groups.size() - 1);
+        std::lock_guard<std::mutex> lock(*m_locks[group]);
+        std::vector<Run> runs(findFreeRuns(group));
+        auto bestFit = findBestFit(runs, count);
+        if (bestFit != runs.end()) {
+            std::vector<Run> fragments { { bestFit->first, count } };
+            fillRuns(fragments);
+            return fragments;
+        }
+    }
+
+    /// The preferred group can't fit it, the runs are looked for in the nearest groups holding enough free indexes
+    std::vector<std::unique_lock<std::mutex>> locks;
+    std::vector<Run> runs;
+    while (true) {
+        std::vector<std::size_t> groups(findNearestGroups(count, preferredGroup));
+        /// Groups are locked in their order, so concurrent allocations can't deadlock
+        std::sort(groups.begin(), groups.end());
+        std::size_t freeCount = 0;
+        for (std::size_t group : groups) {
+            locks.emplace_back(*m_locks[group]);
+            for (const auto &run : findFreeRuns(group)) {
+                freeCount += run.second;
+                if (!runs.empty() && runs.back().first + runs.back().second == run.first) {
+                    /// Run continues from the previous group
+                    runs.back().second += run.second;
+                } else {
+                    runs.push_back(run);
+                }
+            }
+        }
+        if (freeCount >= count) {
+            break;
+        }
+
+        /// Some of the indexes were allocated concurrently before the groups were locked, looking again
+        locks.clear();
+        runs.clear();
+    }
+
+    std::vector<Run> fragments;
+    std::size_t remaining = count;
+    while (remaining > 0) {
+        auto bestFit = findBestFit(runs, remaining);
+        if (bestFit != runs.end()) {
+            fragments.emplace_back(bestFit->first, remaining);
+            break;
+        }
+
+        auto largest = std::max_element(runs.begin(), runs.end(), [](const Run& first, const Run& second) {
+            return first.second < second.second;
+        });
+        if (largest == runs.end()) {
+            throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných indexů bitmapy");
+        }
+        fragments.push_back(*largest);
+        remaining -= largest->second;
+        runs.erase(largest);
+    }
+
+    std::sort(fragments.begin(), fragments.end());
+    fillRuns(fragments);
+    return fragments;
+}
+
+std::vector<std::size_t> pfs::GroupedBitmap::findNearestGroups(const std::size_t count,
+                                                               const std::size_t preferredGroup) const {
+    std::size_t group = std::min(preferredGroup, m_groups.size() - 1);
+    std::vector<std::size_t> groups;
+    std::size_t freeCount = 0;
+    auto addGroup = [&](const std::size_t candidate) {
+        /// Bits of the last group behind the valid indexes are free, but never allocated
+        std::size_t groupStart = candidate * m_indexesPerGroup;
+        std::size_t bitCount = m_groups[candidate].getLength() * 8;
+        std::size_t validCount = std::min(bitCount, (m_indexCount > groupStart) ? (m_indexCount - groupStart) : 0);
+        std::size_t groupFree = getFreeCount(candidate);
+        groupFree -= std::min(groupFree, bitCount - validCount);
+        if (groupFree > 0) {
+            groups.push_back(candidate);
+            freeCount += groupFree;
+        }
+    };
+
+    /// Walking outward - the preferred group, the one behind it, the one in front of it, two groups behind it...
+    for (std::size_t distance = 0; freeCount < count; ++distance) {
+        if (distance > group && group + distance >= m_groups.size()) {
+            throw pfs::ObjectNotFound("Nepodařilo se najít zadané množství volných indexů bitmapy");
+        }
+
+        if (group + distance < m_groups.size()) {
+            addGroup(group + distance);
+        }
+        if (distance > 0 && distance <= group) {
+            addGroup(group - distance);
+        }
+    }
+
+    return groups;
+}
+
+std::size_t pfs::GroupedBitmap::getGroupOffset(const std::size_t group) const {
+    return group * (m_indexesPerGroup / 8);
+}
+
+std::vector<pfs::GroupedBitmap::Run> pfs::GroupedBitmap::findFreeRuns(const std::size_t group) const {
+    std::size_t groupStart = group * m_indexesPerGroup;
+    std::size_t indexCount = (m_indexCount > groupStart) ? (m_indexCount - groupStart) : 0;
+
+    std::vector<Run> runs(m_groups[group].findFreeRuns(indexCount));
+    for (auto &run : runs) {
+        run.first += groupStart;
+    }
+    return runs;
+}
+
+void pfs::GroupedBitmap::fillRuns(const std::vector<Run> &runs) {
+    for (const auto &[start, length] : runs) {
+        for (std::size_t index = start; index < start + length; ++index) {
+            std::size_t group = getGroup(index);
+            m_groups[group].setIndexFilled(index - (group * m_indexesPerGroup));
+        }
+    }
+}
@@ -0,0 +1,109 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_GROUPEDBITMAP_H
+#define PRIMITIVE_FS_GROUPEDBITMAP_H
+
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "../common/structures.h"
+
+namespace pfs {
+
+    /**
+     * Bitmap split into allocation groups of the same number of indexes. Every group is a separate @a fs::Bitmap with
+     * it's own summary, free index count and lock, so allocations in different groups never wait for each other.
+     * Groups are stored one after another, so the stored bitmap is exactly the same as one @a fs::Bitmap of the same
+     * length. The methods of the bitmap itself may be called concurrently. The services using it, the buffer cache and
+     * the block devices are not synchronized, so the file system as a whole is still used from one thread only.
+     */
+    class GroupedBitmap {
+    public: // public attributes
+        /// Run of consecutive indexes, it's first index and length
+        using Run = std::pair<std::size_t, std::size_t>;
+    private: // private attributes
+        /// Bitmaps of the groups
+        std::vector<fs::Bitmap> m_groups;
+        /// Locks of the groups
+        std::vector<std::unique_ptr<std::mutex>> m_locks;
+        /// Number of indexes in one group, multiple of 8
+        std::size_t m_indexesPerGroup = 0;
+        /// Number of valid indexes, the bitmap may have a few more bits
+        std::size_t m_indexCount = 0;
+
+    public: // public methods
+        GroupedBitmap() = default;
+        /**
+         * Creates bitmap of given length with every index free, split into groups of given size. Whole new bitmap is dirty.
+         *
+         * @param length length of the bitmap in bytes
+         * @param indexesPerGroup number of indexes in one group, has to be a multiple of 8
+         * @param indexCount number of valid indexes, indexes behind are never allocated
+         */
+        GroupedBitmap(std::size_t length, std::size_t indexesPerGroup, std::size_t indexCount);
+        /// Returns the number of valid indexes
+        [[nodiscard]] std::size_t getIndexCount() const;
+        /// Returns the number of groups
+        [[nodiscard]] std::size_t getGroupCount() const;
+        /// Returns the group of given index
+        [[nodiscard]] std::size_t getGroup(std::size_t index) const;
+        /// Returns the number of free indexes in the whole bitmap
+        [[nodiscard]] std::size_t getFreeCount() const;
+        /// Returns the number of free indexes in given group
+        [[nodiscard]] std::size_t getFreeCount(std::size_t group) const;
+        /// Returns the group with the most free indexes, the first one of them if there are more
+        [[nodiscard]] std::size_t findEmptiestGroup() const;
+        /// Checks if any group was changed since the bitmap was last saved or loaded
+        [[nodiscard]] bool isDirty() const;
+        /// Saves changed byte ranges of every group into given device, the bitmap starting at given address
+        void save(pfs::BlockDevice& device, std::size_t address);
+        /// Loads every group from given device, the bitmap starting at given address
+        void load(const pfs::BlockDevice& device, std::size_t address);
+        /// Checks if given index is filled
+        [[nodiscard]] bool isIndexFilled(std::size_t index) const;
+        /// Sets given index filled
+        void setIndexFilled(std::size_t index);
+        /// Sets given index free
+        void setIndexFree(std::size_t index);
+        /**
+         * Allocates the first free index of given group. If the group is full, following groups are tried.
+         *
+         * @param preferredGroup group to allocate in
+         * @return allocated index, already set filled
+         * @throw ObjectNotFound if there is no free index
+         */
+        int32_t allocateIndex(std::size_t preferredGroup);
+        /**
+         * Allocates given number of indexes in as few runs of consecutive indexes as possible. Indexes are taken from
+         * the smallest run of given group they all fit into. If there is no such run, only the groups nearest to given
+         * one holding enough free indexes together are locked, and the smallest fitting run of them is taken. If there
+         * is none either, the largest runs are taken until the rest fits into one.
+         *
+         * @param count number of indexes to allocate
+         * @param preferredGroup group to allocate in
+         * @return allocated runs ordered by their first index, already set filled
+         * @throw ObjectNotFound if there is not enough free indexes
+         */
+        std::vector<Run> allocateRuns(std::size_t count, std::size_t preferredGroup);
+
+    private: // private methods
+        /**
+         * Returns the groups nearest to given one that hold at least given number of free indexes together, walking
+         * outward from it and skipping the full groups. Groups are not locked, their free counts may change.
+         *
+         * @throw ObjectNotFound if the whole bitmap doesn't have enough free indexes
+         */
+        [[nodiscard]] std::vector<std::size_t> findNearestGroups(std::size_t count, std::size_t preferredGroup) const;
+        /// Returns index of the first byte of given group
+        [[nodiscard]] std::size_t getGroupOffset(std::size_t group) const;
+        /// Returns the valid runs of free indexes of given group, group has to be locked
+        [[nodiscard]] std::vector<Run> findFreeRuns(std::size_t group) const;
+        /// Sets every index of given runs filled, groups of the runs have to be locked
+        void fillRuns(const std::vector<Run>& runs);
+    };
+}
+
+#endif //PRIMITIVE_FS_GROUPEDBITMAP_H
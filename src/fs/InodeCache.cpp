@@ -0,0 +1,83 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <algorithm>
+#include "InodeCache.h"
+
+pfs::InodeCache::InodeCache(const std::size_t capacity) : m_capacity(capacity) {}
+
+const fs::Inode *pfs::InodeCache::find(const int32_t inodeId) const {
+    auto it = m_entryIndex.find(inodeId);
+    if (it == m_entryIndex.end()) {
+        m_misses++;
+        return nullptr;
+    }
+
+    m_hits++;
+    m_entries.splice(m_entries.begin(), m_entries, it->second);
+    return &it->second->inode;
+}
+
+std::vector<fs::Inode> pfs::InodeCache::put(const fs::Inode &inode, const bool dirty) const {
+    auto it = m_entryIndex.find(inode.getInodeId());
+    if (it != m_entryIndex.end()) {
+        it->second->inode = inode;
+        it->second->dirty = it->second->dirty || dirty;
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        return {};
+    }
+
+    m_entries.push_front({ inode, dirty });
+    m_entryIndex[inode.getInodeId()] = m_entries.begin();
+
+    std::vector<fs::Inode> evicted;
+    while (m_entries.size() > m_capacity) {
+        Entry& entry = m_entries.back();
+        if (entry.dirty) {
+            evicted.push_back(entry.inode);
+        }
+        m_entryIndex.erase(entry.inode.getInodeId());
+        m_entries.pop_back();
+    }
+
+    return evicted;
+}
+
+void pfs::InodeCache::erase(const int32_t inodeId) {
+    auto it = m_entryIndex.find(inodeId);
+    if (it == m_entryIndex.end()) {
+        return;
+    }
+
+    m_entries.erase(it->second);
+    m_entryIndex.erase(it);
+}
+
+std::vector<fs::Inode> pfs::InodeCache::takeDirty() {
+    std::vector<fs::Inode> dirtyInodes;
+    for (auto &entry : m_entries) {
+        if (entry.dirty) {
+            dirtyInodes.push_back(entry.inode);
+            entry.dirty = false;
+        }
+    }
+
+    /// Written in the order they are stored, so the device gets mostly sequential writes
+    std::sort(dirtyInodes.begin(), dirtyInodes.end(), [](const fs::Inode& first, const fs::Inode& second) {
+        return first.getInodeId() < second.getInodeId();
+    });
+    return dirtyInodes;
+}
+
+pfs::CacheStatistics pfs::InodeCache::getStatistics() const {
+    CacheStatistics statistics;
+    statistics.hits = m_hits;
+    statistics.misses = m_misses;
+    statistics.cached = m_entries.size();
+    statistics.capacity = m_capacity;
+    statistics.dirty = std::count_if(m_entries.begin(), m_entries.end(), [](const Entry& entry) {
+        return entry.dirty;
+    });
+    return statistics;
+}
@@ -0,0 +1,88 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_INODECACHE_H
+#define PRIMITIVE_FS_INODECACHE_H
+
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include "BufferCache.h"
+#include "../common/structures.h"
+
+namespace pfs {
+
+    /**
+     * Write-back cache of i-nodes with fixed budget, keyed by i-node ID. Saved i-nodes are only marked dirty, writing
+     * them into the data file is left to the owner of the cache. When the budget is exceeded, least recently used
+     * i-nodes are evicted and the dirty ones among them are handed back to the owner to be written.
+     */
+    class InodeCache {
+    private: // private attributes
+        /**
+         * One cached i-node.
+         */
+        struct Entry {
+            /// Cached i-node
+            fs::Inode inode;
+            /// Was the i-node modified since it was written into the data file?
+            bool dirty;
+        };
+
+        /// Maximal number of cached i-nodes
+        std::size_t m_capacity = 0;
+        /// Cached i-nodes, most recently used at the front
+        mutable std::list<Entry> m_entries;
+        /// Cached i-nodes by their ID
+        mutable std::unordered_map<int32_t, std::list<Entry>::iterator> m_entryIndex;
+        /// Number of lookups served from the cache
+        mutable std::size_t m_hits = 0;
+        /// Number of lookups that missed the cache
+        mutable std::size_t m_misses = 0;
+
+    public: // public methods
+        InodeCache() = default;
+        /**
+         * Creates an empty cache.
+         *
+         * @param capacity maximal number of cached i-nodes, zero disables caching
+         */
+        explicit InodeCache(std::size_t capacity);
+        /**
+         * Returns cached i-node with given ID and marks it as the most recently used one.
+         *
+         * @param inodeId ID of wanted i-node
+         * @return cached i-node or null if the i-node is not cached
+         */
+        [[nodiscard]] const fs::Inode* find(int32_t inodeId) const;
+        /**
+         * Stores given i-node into the cache as the most recently used one, replacing the cached one with the same ID.
+         *
+         * @param inode i-node to store
+         * @param dirty was the i-node modified, so it has to be written into the data file later?
+         * @return dirty i-nodes evicted to meet the budget, they have to be written by the caller
+         */
+        std::vector<fs::Inode> put(const fs::Inode& inode, bool dirty) const;
+        /**
+         * Drops the i-node with given ID from the cache, if cached, without writing it anywhere.
+         *
+         * @param inodeId ID of the i-node to drop
+         */
+        void erase(int32_t inodeId);
+        /**
+         * Returns all dirty i-nodes ordered by their ID and marks them clean. I-nodes stay cached.
+         *
+         * @return i-nodes that have to be written by the caller
+         */
+        std::vector<fs::Inode> takeDirty();
+        /**
+         * Returns current statistics of this cache.
+         *
+         * @return cache statistics
+         */
+        [[nodiscard]] CacheStatistics getStatistics() const;
+    };
+}
+
+#endif //PRIMITIVE_FS_INODECACHE_H
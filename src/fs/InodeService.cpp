@@ -5,18 +5,19 @@
 #include "InodeService.h"
 #include <utility>
 
-pfs::InodeService::InodeService(std::string mDataFileName, fs::Bitmap inodeBitmap,
-                                int32_t inodeBitmapAddress, int32_t inodeStartAddress)
-                                : m_dataFileName(std::move(mDataFileName)), m_inodeBitmap(std::move(inodeBitmap)),
-                                m_inodeBitmapAddress(inodeBitmapAddress), m_inodeStartAddress(inodeStartAddress) {
+pfs::InodeService::InodeService(std::shared_ptr<pfs::BlockDevice> device, const fs::Superblock& superblock,
+                                pfs::GroupedBitmap inodeBitmap, const std::size_t cacheCapacity)
+                                : m_device(std::move(device)), m_inodeBitmap(std::move(inodeBitmap)),
+                                m_inodeBitmapAddress(superblock.getInodeBitmapStartAddress()),
+                                m_inodeStartAddress(superblock.getInodeStartAddress()), m_cache(cacheCapacity) {
 }
 
-int32_t pfs::InodeService::getInodeId() const {
-    return m_inodeBitmap.findFirstFreeIndex();
+int32_t pfs::InodeService::allocateInodeId(const std::size_t group) {
+    return m_inodeBitmap.allocateIndex(group);
 }
 
-fs::Inode pfs::InodeService::createInode(const bool isDirectory, const int32_t fileSize) const {
-    return fs::Inode(getInodeId(), isDirectory, fileSize);
+fs::Inode pfs::InodeService::createInode(const bool isDirectory, const int64_t fileSize, const std::size_t group) {
+    return fs::Inode(allocateInodeId(group), isDirectory, fileSize);
 }
 
 void pfs::InodeService::saveInode(const fs::Inode &inode) {
@@ -24,27 +25,21 @@ void pfs::InodeService::saveInode(const fs::Inode &inode) {
         throw std::invalid_argument("Nelze uložit i-uzel bez unikátního ID");
     }
 
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru");
-    }
-
-    inode.save(dataFile, m_inodeStartAddress + (inode.getInodeId() * sizeof(inode)));
+    writeInodes(m_cache.put(inode, true));
 
-    /// Updating the bitmap
+    /// Updating the bitmap, the id is already allocated unless the inode is root
     m_inodeBitmap.setIndexFilled(inode.getInodeId());
-    m_inodeBitmap.save(dataFile, m_inodeBitmapAddress);
 }
 
 fs::Inode pfs::InodeService::findInode(const int inodeId) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při čtení ze souboru");
+    if (const fs::Inode* cached = m_cache.find(inodeId)) {
+        return *cached;
     }
 
     fs::Inode inode;
-    inode.load(dataFile, m_inodeStartAddress + (inodeId * sizeof(fs::Inode)));
+    inode.load(*m_device, getInodeAddress(inodeId));
     if (inode.getInodeId() == inodeId) {
+        writeInodes(m_cache.put(inode, false));
         return inode;
     }
 
@@ -53,42 +48,47 @@ fs::Inode pfs::InodeService::findInode(const int inodeId) const {
 }
 
 void pfs::InodeService::removeInode(const fs::Inode &inode) {
-    std::fstream dataFile(m_dataFileName, std::ios::out | std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios_base::failure("Chyba při otevírání datového souboru!");
-    }
+    m_cache.erase(inode.getInodeId());
+    m_device->zero(getInodeAddress(inode.getInodeId()), fs::Inode::DISK_SIZE);
 
-    std::array<int, fs::Superblock::CLUSTER_SIZE> buffer { 0 };
+    m_inodeBitmap.setIndexFree(inode.getInodeId());
+}
 
-    dataFile.seekp(m_inodeStartAddress + (inode.getInodeId() * sizeof(inode)));
-    dataFile.write((char*)buffer.data(), sizeof(inode));
-    dataFile.flush();
+void pfs::InodeService::flush() {
+    if (!m_device) {
+        return;
+    }
 
-    m_inodeBitmap.setIndexFree(inode.getInodeId());
-    m_inodeBitmap.save(dataFile, m_inodeBitmapAddress);
+    writeInodes(m_cache.takeDirty());
+    if (m_inodeBitmap.isDirty()) {
+        m_inodeBitmap.save(*m_device, m_inodeBitmapAddress);
+    }
+}
+
+pfs::CacheStatistics pfs::InodeService::getCacheStatistics() const {
+    return m_cache.getStatistics();
 }
 
 void pfs::InodeService::getRootInode(fs::Inode &rootInode) const {
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
+    if (!m_device) {
         return;
     }
 
-    rootInode.load(dataFile, m_inodeStartAddress);
+    rootInode = findInode(0);
 }
 
 std::vector<fs::Inode> pfs::InodeService::getAllInodes() const {
     std::vector<fs::Inode> inodes;
     fs::Inode inode;
 
-    std::ifstream dataFile(m_dataFileName, std::ios::in | std::ios::binary);
-    if (!dataFile) {
-        throw std::ios::failure("Chyba při otevítání datového souboru");
-    }
-
-    for (int i = 0; i < m_inodeBitmap.getLength() * 8; ++i) {
+    for (std::size_t i = 0; i < m_inodeBitmap.getIndexCount(); ++i) {
         if (m_inodeBitmap.isIndexFilled(i)) {
-            inode.load(dataFile, m_inodeStartAddress + i * sizeof(inode));
+            /// Inodes missing in the cache are not added to it, so the scan doesn't evict the working set
+            if (const fs::Inode* cached = m_cache.find(i)) {
+                inodes.push_back(*cached);
+                continue;
+            }
+            inode.load(*m_device, getInodeAddress(i));
             inodes.push_back(inode);
         }
     }
@@ -96,3 +96,22 @@ std::vector<fs::Inode> pfs::InodeService::getAllInodes() const {
     return inodes;
 }
 
+std::size_t pfs::InodeService::getInodeAddress(const int32_t inodeId) const {
+    return m_inodeStartAddress + (inodeId * fs::Inode::DISK_SIZE);
+}
+
+void pfs::InodeService::writeInodes(const std::vector<fs::Inode> &inodes) const {
+    if (inodes.empty()) {
+        return;
+    }
+
+    /// Inodes are encoded into one buffer and written as one batch, so the device may merge the adjacent ones
+    std::vector<u_char> records(inodes.size() * fs::Inode::DISK_SIZE);
+    std::vector<pfs::WriteRequest> writes;
+    for (std::size_t i = 0; i < inodes.size(); ++i) {
+        u_char* record = records.data() + (i * fs::Inode::DISK_SIZE);
+        inodes[i].encode(record);
+        writes.push_back({ getInodeAddress(inodes[i].getInodeId()), record, fs::Inode::DISK_SIZE });
+    }
+    m_device->writeBatch(writes);
+}
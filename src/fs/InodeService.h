@@ -6,7 +6,11 @@
 #define PRIMITIVE_FS_INODESERVICE_H
 
 
+#include <memory>
 #include "FileData.h"
+#include "BlockDevice.h"
+#include "GroupedBitmap.h"
+#include "InodeCache.h"
 
 namespace pfs {
 
@@ -15,40 +19,46 @@ namespace pfs {
      */
     class InodeService {
     private: // private attributes
-        /// Data file representing the virtual file system
-        std::string m_dataFileName;
-        /// Inode bitmap
-        fs::Bitmap m_inodeBitmap;
+        /// Device representing the data file of the virtual file system
+        std::shared_ptr<pfs::BlockDevice> m_device;
+        /// Inode bitmap, split into allocation groups
+        pfs::GroupedBitmap m_inodeBitmap;
         /// Address where to store the inode bitmap
-        int32_t m_inodeBitmapAddress = -1;
+        std::size_t m_inodeBitmapAddress = 0;
         /// Address where the inode storage begins
-        int32_t m_inodeStartAddress = -1;
+        std::size_t m_inodeStartAddress = 0;
+        /// Recently used inodes, saved inodes are written into the data file on flush or eviction
+        pfs::InodeCache m_cache;
 
     public: // public methods
         InodeService() = default;
-        InodeService(std::string mDataFileName, fs::Bitmap inodeBitmap,
-                     int32_t inodeBitmapAddress, int32_t inodeStartAddress);
+        InodeService(std::shared_ptr<pfs::BlockDevice> device, const fs::Superblock& superblock,
+                     pfs::GroupedBitmap inodeBitmap, std::size_t cacheCapacity);
         /**
-         * Returns smallest available inode id, if any is available, otherwise throws ObjectNotFound.
+         * Allocates smallest available inode id of given allocation group, or of the following groups if it's full.
          * Returned id is also an offset from the beginning of the inode storage, meaning that inode with id = 3
-         * will be stored at 3 * sizeof(fs::Inode) from the inode storage start.
+         * will be stored at 3 * fs::Inode::DISK_SIZE from the inode storage start.
          *
+         * @param group allocation group to allocate the id in
          * @throw pfs::ObjectNotFound If no free i-node id was found
-         * @return smallest available inode id
+         * @return allocated inode id
          */
-        [[nodiscard]] int32_t getInodeId() const;
+        int32_t allocateInodeId(std::size_t group);
         /**
          * Creates an instance of fs::Inode based on given parameters. This factory method should be used for creation of every
          * inode instance, which is intended to be saved into the data file, since it checks side effects of creating inode,
-         * such as if there is any space left for new inode instance in out file system.
+         * such as if there is any space left for new inode instance in out file system. The id of created inode is
+         * allocated right away, if the inode is not saved in the end, it has to be released by @a removeInode.
          *
          * @param isDirectory will inode represent a directory?
          * @param fileSize size of the represented file
+         * @param group allocation group to create the inode in
          * @return fs::Inode instance
          */
-        [[nodiscard]] fs::Inode createInode(bool isDirectory, int32_t fileSize) const;
+        fs::Inode createInode(bool isDirectory, int64_t fileSize, std::size_t group);
         /**
-         * Saves given inode into data file.
+         * Saves given inode into the inode cache and marks it dirty, it's written into the data file on @a flush
+         * or when it's evicted from the cache.
          *
          * @param inode inode to save
          */
@@ -61,8 +71,8 @@ namespace pfs {
          */
         [[nodiscard]] fs::Inode findInode(int inodeId) const;
         /**
-         * Deletes given inode from the data file. Note that this method will not delete inode's data at direct
-         * and indirect links.
+         * Deletes given inode from the data file and the inode cache. Note that this method will not delete inode's
+         * data at direct and indirect links.
          *
          * @param inode inode to delete
          */
@@ -73,11 +83,28 @@ namespace pfs {
          * @param rootInode instance to store rootInode data into
          */
         void getRootInode(fs::Inode &rootInode) const;
+        /**
+         * Writes dirty inodes from the cache and changed parts of the inode bitmap. Saved inodes and changes of the bitmap
+         * made by saving and removing inodes are kept only in the memory until this method is called.
+         */
+        void flush();
+        /**
+         * Returns current statistics of the inode cache.
+         *
+         * @return inode cache statistics
+         */
+        [[nodiscard]] pfs::CacheStatistics getCacheStatistics() const;
         /**
          * Returns a vector of all inodes saved in the file system.
          * @return vector of all inodes
          */
         [[nodiscard]] std::vector<fs::Inode> getAllInodes() const;
+
+    private: // private methods
+        /// Returns the address where the inode with given id is stored
+        [[nodiscard]] std::size_t getInodeAddress(int32_t inodeId) const;
+        /// Writes given inodes into the data file
+        void writeInodes(const std::vector<fs::Inode>& inodes) const;
     };
 }
 
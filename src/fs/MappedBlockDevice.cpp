@@ -0,0 +1,97 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstring>
+#include <ios>
+#include "MappedBlockDevice.h"
+
+pfs::MappedBlockDevice::MappedBlockDevice(const std::string &fileName, const bool truncate, const std::size_t size) {
+    int flags = O_RDWR;
+    if (truncate) {
+        flags |= O_CREAT | O_TRUNC;
+    }
+
+    m_fd = ::open(fileName.c_str(), flags, 0644);
+    if (m_fd < 0) {
+        throw std::ios_base::failure("Chyba při otevírání datového souboru");
+    }
+
+    if (truncate) {
+        if (::ftruncate(m_fd, size) < 0) {
+            ::close(m_fd);
+            throw std::ios_base::failure("Chyba při změně velikosti datového souboru");
+        }
+        m_size = size;
+    } else {
+        struct stat fileStat {};
+        if (::fstat(m_fd, &fileStat) < 0) {
+            ::close(m_fd);
+            throw std::ios_base::failure("Chyba při zjišťování velikosti datového souboru");
+        }
+        m_size = fileStat.st_size;
+    }
+
+    if (m_size == 0) {
+        /// There is nothing to map, every read will return zeros
+        return;
+    }
+
+    void* data = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(m_fd);
+        throw std::ios_base::failure("Chyba při mapování datového souboru do paměti");
+    }
+    m_data = static_cast<char*>(data);
+}
+
+pfs::MappedBlockDevice::~MappedBlockDevice() {
+    if (m_data != nullptr) {
+        ::munmap(m_data, m_size);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+}
+
+void pfs::MappedBlockDevice::read(const std::size_t address, void *buffer, const std::size_t length) const {
+    std::size_t mapped = 0;
+    if (address < m_size) {
+        mapped = std::min(length, m_size - address);
+        std::memcpy(buffer, m_data + address, mapped);
+    }
+
+    /// Bytes behind the end of the data file are read as zeros
+    std::memset(static_cast<char*>(buffer) + mapped, 0, length - mapped);
+}
+
+void pfs::MappedBlockDevice::write(const std::size_t address, const void *buffer, const std::size_t length) {
+    if (address + length > m_size) {
+        throw std::ios_base::failure("Zápis mimo namapovaný datový soubor");
+    }
+
+    std::memcpy(m_data + address, buffer, length);
+}
+
+void pfs::MappedBlockDevice::zero(const std::size_t address, const std::size_t length) {
+    if (address + length > m_size) {
+        throw std::ios_base::failure("Zápis mimo namapovaný datový soubor");
+    }
+
+    std::memset(m_data + address, 0, length);
+}
+
+void pfs::MappedBlockDevice::sync() {
+    if (m_data != nullptr && ::msync(m_data, m_size, MS_SYNC) < 0) {
+        throw std::ios_base::failure("Chyba při synchronizaci datového souboru");
+    }
+}
+
+std::size_t pfs::MappedBlockDevice::size() const {
+    return m_size;
+}
@@ -0,0 +1,47 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_MAPPEDBLOCKDEVICE_H
+#define PRIMITIVE_FS_MAPPEDBLOCKDEVICE_H
+
+#include "BlockDevice.h"
+
+namespace pfs {
+
+    /**
+     * Block device mapping the whole data file into the memory. Reads and writes are plain memory copies from and into
+     * the mapped bytes, leaving the paging to the kernel.
+     */
+    class MappedBlockDevice : public BlockDevice {
+    private: // private attributes
+        /// Descriptor of the opened data file
+        int m_fd = -1;
+        /// Start of the mapped data file
+        char* m_data = nullptr;
+        /// Number of mapped bytes
+        std::size_t m_size = 0;
+
+    public: // public methods
+        /**
+         * Opens the data file with given name and maps it into the memory. If @a truncate is true, the data file
+         * is created if it does not exist, it's previous content is discarded and it is resized to @a size bytes
+         * before being mapped.
+         *
+         * @param fileName name of the data file
+         * @param truncate should the data file be created or truncated?
+         * @param size size of the truncated data file
+         * @throw std::ios_base::failure if the data file cannot be opened or mapped
+         */
+        MappedBlockDevice(const std::string& fileName, bool truncate, std::size_t size);
+        ~MappedBlockDevice() override;
+
+        void read(std::size_t address, void* buffer, std::size_t length) const override;
+        void write(std::size_t address, const void* buffer, std::size_t length) override;
+        void zero(std::size_t address, std::size_t length) override;
+        void sync() override;
+        [[nodiscard]] std::size_t size() const override;
+    };
+}
+
+#endif //PRIMITIVE_FS_MAPPEDBLOCKDEVICE_H
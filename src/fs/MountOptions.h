@@ -0,0 +1,111 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_MOUNTOPTIONS_H
+#define PRIMITIVE_FS_MOUNTOPTIONS_H
+
+#include <string>
+#include "../utils/StringNumberConverter.h"
+
+namespace pfs {
+
+    /**
+     * Backends that may be used to access the data file of the file system.
+     */
+    enum class IoBackend {
+        /**
+         * Positioned reads and writes on an open descriptor of the data file.
+         */
+        PREAD,
+        /**
+         * Whole data file mapped into the memory.
+         */
+        MMAP,
+        /**
+         * Linux io_uring interface, allowing many batched reads and writes to be in flight at once.
+         */
+        URING
+    };
+
+    /**
+     * Ways data of new regular files may be mapped by their i-nodes. Directories are always mapped by links.
+     */
+    enum class FileMapping {
+        /**
+         * Direct and indirect links, one for every cluster.
+         */
+        LINKS,
+        /**
+         * Runs of consecutive clusters, stored in the i-node or in an extent tree.
+         */
+        EXTENTS
+    };
+
+    /**
+     * Options the file system is mounted with. Options are passed from CLI after the name of the data file,
+     * eg. "--io=pread --cache=256".
+     */
+    struct MountOptions {
+        /// Option setting the number of clusters kept in the buffer cache
+        inline static const std::string CACHE_OPTION = "--cache=";
+        /// Option setting the number of i-nodes kept in the i-node cache
+        inline static const std::string INODE_CACHE_OPTION = "--inode-cache=";
+        /// Option setting the number of directory items kept in the dentry cache
+        inline static const std::string DENTRY_CACHE_OPTION = "--dentry-cache=";
+        /// Backend used to access the data file
+        IoBackend ioBackend = IoBackend::MMAP;
+        /// Mapping of new regular files
+        FileMapping fileMapping = FileMapping::EXTENTS;
+        /// Maximal number of clusters kept in the buffer cache, zero disables the cache
+        std::size_t cacheClusters = 1024;
+        /// Maximal number of i-nodes kept in the i-node cache, zero disables the cache
+        std::size_t cacheInodes = 4096;
+        /// Maximal number of resolved directory items kept in the dentry cache, zero disables the cache
+        std::size_t cacheDentries = 4096;
+
+        /**
+         * Parses one CLI option and stores it's value into this instance.
+         *
+         * @param option option passed from CLI
+         * @return true if the option was recognized and has valid value, otherwise false
+         */
+        bool parseOption(const std::string& option) {
+            if (option == "--io=pread") {
+                ioBackend = IoBackend::PREAD;
+            } else if (option == "--io=mmap") {
+                ioBackend = IoBackend::MMAP;
+            } else if (option == "--io=uring") {
+                ioBackend = IoBackend::URING;
+            } else if (option == "--mapping=links") {
+                fileMapping = FileMapping::LINKS;
+            } else if (option == "--mapping=extents") {
+                fileMapping = FileMapping::EXTENTS;
+            } else if (option.rfind(CACHE_OPTION, 0) == 0) {
+                ConversionResult result = StringNumberConverter::convertStringToInt(option.substr(CACHE_OPTION.length()));
+                if (!result.success || result.value < 0) {
+                    return false;
+                }
+                cacheClusters = result.value;
+            } else if (option.rfind(INODE_CACHE_OPTION, 0) == 0) {
+                ConversionResult result = StringNumberConverter::convertStringToInt(option.substr(INODE_CACHE_OPTION.length()));
+                if (!result.success || result.value < 0) {
+                    return false;
+                }
+                cacheInodes = result.value;
+            } else if (option.rfind(DENTRY_CACHE_OPTION, 0) == 0) {
+                ConversionResult result = StringNumberConverter::convertStringToInt(option.substr(DENTRY_CACHE_OPTION.length()));
+                if (!result.success || result.value < 0) {
+                    return false;
+                }
+                cacheDentries = result.value;
+            } else {
+                return false;
+            }
+
+            return true;
+        }
+    };
+}
+
+#endif //PRIMITIVE_FS_MOUNTOPTIONS_H
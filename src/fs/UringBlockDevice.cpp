@@ -0,0 +1,209 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <ios>
+#include "UringBlockDevice.h"
+
+namespace {
+    /// Reads value shared with the kernel, so that everything the kernel wrote before is visible
+    unsigned loadAcquire(const unsigned* value) {
+        return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+    }
+
+    /// Stores value shared with the kernel, so that everything written before is visible to the kernel
+    void storeRelease(unsigned* value, unsigned newValue) {
+        __atomic_store_n(value, newValue, __ATOMIC_RELEASE);
+    }
+
+    /// Returns pointer to a field at given offset of a mapped ring
+    template<typename T>
+    T* ringField(void* ring, std::size_t offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(ring) + offset);
+    }
+}
+
+pfs::UringBlockDevice::UringBlockDevice(const std::string &fileName, const bool truncate, const std::size_t size)
+                        : FileBlockDevice(fileName, truncate, size) {
+    if (!setupRing()) {
+        releaseRing();
+    }
+}
+
+pfs::UringBlockDevice::~UringBlockDevice() {
+    releaseRing();
+}
+
+bool pfs::UringBlockDevice::setupRing() {
+    m_ringFd = static_cast<int>(::syscall(__NR_io_uring_setup, QUEUE_DEPTH, &m_params));
+    if (m_ringFd < 0) {
+        return false;
+    }
+
+    m_sqEntries = m_params.sq_entries;
+    m_sqRingSize = m_params.sq_off.array + m_params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMap = m_params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMap) {
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+    }
+
+    void* sqRing = ::mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          m_ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        return false;
+    }
+    m_sqRing = sqRing;
+
+    if (singleMap) {
+        m_cqRing = m_sqRing;
+    } else {
+        void* cqRing = ::mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              m_ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            return false;
+        }
+        m_cqRing = cqRing;
+    }
+
+    void* sqes = ::mmap(nullptr, m_sqEntries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_ringFd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+    return true;
+}
+
+void pfs::UringBlockDevice::releaseRing() {
+    if (m_sqes != nullptr) {
+        ::munmap(m_sqes, m_sqEntries * sizeof(io_uring_sqe));
+        m_sqes = nullptr;
+    }
+    if (m_cqRing != nullptr && m_cqRing != m_sqRing) {
+        ::munmap(m_cqRing, m_cqRingSize);
+    }
+    m_cqRing = nullptr;
+    if (m_sqRing != nullptr) {
+        ::munmap(m_sqRing, m_sqRingSize);
+        m_sqRing = nullptr;
+    }
+    if (m_ringFd >= 0) {
+        ::close(m_ringFd);
+        m_ringFd = -1;
+    }
+}
+
+void pfs::UringBlockDevice::readBatch(const std::vector<ReadRequest> &requests) const {
+    if (m_ringFd < 0) {
+        FileBlockDevice::readBatch(requests);
+        return;
+    }
+
+    std::vector<IoRun> runs = mergeRuns(requests);
+    submitAll(runs.size(), [this, &runs](io_uring_sqe& sqe, std::size_t index) {
+        sqe.opcode = IORING_OP_READV;
+        sqe.fd = m_fd;
+        sqe.off = runs[index].address;
+        sqe.addr = reinterpret_cast<uint64_t>(runs[index].vectors.data());
+        sqe.len = runs[index].vectors.size();
+    }, [this, &runs](std::size_t index, std::size_t transferred) {
+        readRun(runs[index], transferred);
+    });
+}
+
+void pfs::UringBlockDevice::writeBatch(const std::vector<WriteRequest> &requests) {
+    if (m_ringFd < 0) {
+        FileBlockDevice::writeBatch(requests);
+        return;
+    }
+
+    std::vector<IoRun> runs = mergeRuns(requests);
+    submitAll(runs.size(), [this, &runs](io_uring_sqe& sqe, std::size_t index) {
+        sqe.opcode = IORING_OP_WRITEV;
+        sqe.fd = m_fd;
+        sqe.off = runs[index].address;
+        sqe.addr = reinterpret_cast<uint64_t>(runs[index].vectors.data());
+        sqe.len = runs[index].vectors.size();
+    }, [this, &runs](std::size_t index, std::size_t transferred) {
+        /// Writing through the file device, the runs themselves are not modified
+        const_cast<UringBlockDevice*>(this)->writeRun(runs[index], transferred);
+    });
+}
+
+template<typename Prepare, typename Finish>
+void pfs::UringBlockDevice::submitAll(const std::size_t count, Prepare prepare, Finish finish) const {
+    auto* sqTail = ringField<unsigned>(m_sqRing, m_params.sq_off.tail);
+    auto* sqMask = ringField<unsigned>(m_sqRing, m_params.sq_off.ring_mask);
+    auto* sqArray = ringField<unsigned>(m_sqRing, m_params.sq_off.array);
+    auto* cqHead = ringField<unsigned>(m_cqRing, m_params.cq_off.head);
+    auto* cqTail = ringField<unsigned>(m_cqRing, m_params.cq_off.tail);
+    auto* cqMask = ringField<unsigned>(m_cqRing, m_params.cq_off.ring_mask);
+    auto* cqes = ringField<io_uring_cqe>(m_cqRing, m_params.cq_off.cqes);
+
+    std::vector<std::size_t> completed;
+    std::size_t next = 0;
+    std::size_t inFlight = 0;
+    unsigned toSubmit = 0;
+    bool failed = false;
+    /// After a failure nothing more is submitted, only the requests in flight are waited for
+    while ((!failed && next < count) || inFlight > 0) {
+        /// Filling the submission queue as long as there are free entries
+        unsigned tail = *sqTail;
+        while (!failed && next < count && inFlight < m_sqEntries) {
+            unsigned index = tail & *sqMask;
+            io_uring_sqe& sqe = m_sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            prepare(sqe, next);
+            sqe.user_data = next;
+            sqArray[index] = index;
+            tail++;
+            next++;
+            inFlight++;
+            toSubmit++;
+        }
+        storeRelease(sqTail, tail);
+
+        int submitted = static_cast<int>(::syscall(__NR_io_uring_enter, m_ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS,
+                                                   nullptr, 0));
+        if (submitted < 0) {
+            if (errno != EINTR) {
+                /// The ring can't be entered anymore, so the requests in flight can't be waited for
+                throw std::ios_base::failure("Chyba při odesílání požadavků na datový soubor");
+            }
+        } else {
+            toSubmit -= submitted;
+        }
+
+        /// Reaping every completed request
+        unsigned head = *cqHead;
+        while (head != loadAcquire(cqTail)) {
+            const io_uring_cqe& cqe = cqes[head & *cqMask];
+            if (cqe.res < 0) {
+                failed = true;
+            } else {
+                completed.push_back(cqe.user_data);
+                completed.push_back(cqe.res);
+            }
+            head++;
+            inFlight--;
+        }
+        storeRelease(cqHead, head);
+    }
+
+    if (failed) {
+        throw std::ios_base::failure("Chyba při vyřizování požadavků na datový soubor");
+    }
+
+    /// Requests transferred only partially are finished synchronously, which also handles the end of the data file
+    for (std::size_t i = 0; i < completed.size(); i += 2) {
+        finish(completed[i], completed[i + 1]);
+    }
+}
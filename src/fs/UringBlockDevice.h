@@ -0,0 +1,74 @@
+//
+// Author: markovd@students.zcu.cz
+//
+
+#ifndef PRIMITIVE_FS_URINGBLOCKDEVICE_H
+#define PRIMITIVE_FS_URINGBLOCKDEVICE_H
+
+#include <linux/io_uring.h>
+#include "FileBlockDevice.h"
+
+namespace pfs {
+
+    /**
+     * Block device submitting batched reads and writes through the Linux io_uring interface. Adjacent requests
+     * of a batch are merged into vectored runs like in @a FileBlockDevice and up to @a QUEUE_DEPTH runs are in flight
+     * at once. Single reads and writes are performed by pread/pwrite. If the kernel refuses to set the ring up,
+     * batches are performed by preadv/pwritev one run at a time.
+     */
+    class UringBlockDevice : public FileBlockDevice {
+    public: // public attributes
+        /// Maximal number of runs in flight
+        static constexpr unsigned QUEUE_DEPTH = 128;
+    private: // private attributes
+        /// Descriptor of the io_uring instance, negative if the ring could not be set up
+        int m_ringFd = -1;
+        /// Mapped submission queue ring
+        void* m_sqRing = nullptr;
+        /// Size of the mapped submission queue ring
+        std::size_t m_sqRingSize = 0;
+        /// Mapped completion queue ring
+        void* m_cqRing = nullptr;
+        /// Size of the mapped completion queue ring
+        std::size_t m_cqRingSize = 0;
+        /// Mapped submission queue entries
+        io_uring_sqe* m_sqes = nullptr;
+        /// Number of submission queue entries
+        unsigned m_sqEntries = 0;
+        /// Offsets of the fields inside the rings
+        io_uring_params m_params {};
+
+    public: // public methods
+        /**
+         * Opens the data file with given name for reading and writing and sets the io_uring instance up.
+         *
+         * @param fileName name of the data file
+         * @param truncate should the data file be created or truncated?
+         * @param size size of the truncated data file
+         * @throw std::ios_base::failure if the data file cannot be opened
+         */
+        UringBlockDevice(const std::string& fileName, bool truncate, std::size_t size);
+        ~UringBlockDevice() override;
+
+        void readBatch(const std::vector<ReadRequest>& requests) const override;
+        void writeBatch(const std::vector<WriteRequest>& requests) override;
+
+    private: // private methods
+        /// Sets the io_uring instance up, returns false if the kernel doesn't allow it
+        bool setupRing();
+        /// Releases the io_uring instance
+        void releaseRing();
+        /**
+         * Submits given number of runs, keeping at most @a QUEUE_DEPTH of them in flight, and waits for all of them.
+         * Runs completed only partially are finished synchronously.
+         *
+         * @param count number of runs
+         * @param prepare function filling submission queue entry for the run with given index
+         * @param finish function finishing the run with given index from given number of already transferred bytes
+         */
+        template<typename Prepare, typename Finish>
+        void submitAll(std::size_t count, Prepare prepare, Finish finish) const;
+    };
+}
+
+#endif //PRIMITIVE_FS_URINGBLOCKDEVICE_H
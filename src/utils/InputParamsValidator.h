@@ -9,6 +9,8 @@
 #include <charconv>
 #include <iostream>
 #include <filesystem>
+#include <string>
+#include <vector>
 
 /**
  * Static utility class for input parameter validation.
@@ -16,11 +18,6 @@
 class InputParamsValidator {
 private:
 
-    /**
-     * Required number of CLI parameters passed to application.
-     */
-    static constexpr int REQUIRED_CLI_PARAMS_COUNT = 2;
-
     /**
      * Required number of parameters to pass to the fnct::format function.
      */
@@ -33,11 +30,21 @@ private:
 
 public://public methods
 
+    /**
+     * Required number of CLI parameters passed to application.
+     */
+    static constexpr int REQUIRED_CLI_PARAMS_COUNT = 2;
+
     /**
      * Return code for invalid number of arguments being passed from CLI.
      */
     static constexpr int EXIT_INVALID_ARG_COUNT = -1;
 
+    /**
+     * Return code for invalid option being passed from CLI.
+     */
+    static constexpr int EXIT_INVALID_OPTION = -2;
+
     /**
      * Validates parameters passed from CLI. Since there should be always only one parameter - name of the
      * file representing our file system, we are validating only to parameter count, since with non-existing file